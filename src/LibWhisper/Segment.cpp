@@ -0,0 +1,234 @@
+#include <Segment.h>
+
+#include <algorithm>
+
+// a chunk is rebuilt once removed text exceeds its live text and this much
+#define SEGMENT_STORE_MIN_GARBAGE 1024
+
+std::string to_string(const OrderedSegments & segments) {
+    size_t length = 0;
+    for (const auto &segment : segments) {
+        length += segment.text.size();
+    }
+
+    std::string result;
+    result.reserve(length);
+
+    for (const auto &segment : segments) {
+        result += segment.text;
+    }
+
+    return result;
+}
+
+SegmentStore::const_iterator & SegmentStore::const_iterator::operator++() {
+    if (++i == store->chunks[chunk]->entries.size()) {
+        ++chunk;
+        i = 0;
+    }
+
+    return *this;
+}
+
+SegmentRef SegmentStore::ref(const Chunk &chunk, size_t i) const {
+    const Entry &entry = chunk.entries[i];
+
+    return SegmentRef { std::string_view(chunk.text).substr(entry.offset, entry.length), entry.t0, entry.t1, entry.speaker, (*models)[entry.model] };
+}
+
+SegmentRef SegmentStore::operator[](size_t i) const {
+    const auto [c, j] = locate(i);
+
+    return ref(*chunks[c], j);
+}
+
+std::pair<size_t, size_t> SegmentStore::locate(size_t i) const {
+    // segments are mostly looked up near the end, where new ones go and partial ones are replaced
+    if (i >= count/2) {
+        size_t n = count;
+        for (size_t c = chunks.size(); c > 0; --c) {
+            n -= chunks[c - 1]->entries.size();
+            if (i >= n) {
+                return { c - 1, i - n };
+            }
+        }
+    }
+
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        if (i < chunks[c]->entries.size()) {
+            return { c, i };
+        }
+        i -= chunks[c]->entries.size();
+    }
+
+    return { chunks.size() - 1, chunks.back()->entries.size() };
+}
+
+SegmentStore::Chunk & SegmentStore::modify(size_t c) {
+    // a copy of the store still reads it, it must not see the change
+    if (chunks[c].use_count() > 1) {
+        chunks[c] = rebuild(*chunks[c], 0, chunks[c]->entries.size());
+    }
+
+    return *chunks[c];
+}
+
+std::shared_ptr<SegmentStore::Chunk> SegmentStore::rebuild(const Chunk &chunk, size_t first, size_t last) {
+    auto rebuilt = std::make_shared<Chunk>();
+
+    rebuilt->entries.reserve(std::max<size_t>(last - first, SEGMENT_STORE_CHUNK_SIZE));
+    rebuilt->text.reserve(chunk.text.size() - chunk.garbage);
+
+    for (size_t i = first; i < last; ++i) {
+        Entry entry = chunk.entries[i];
+
+        rebuilt->text.append(chunk.text, entry.offset, entry.length);
+        entry.offset = rebuilt->text.size() - entry.length;
+
+        rebuilt->entries.push_back(entry);
+    }
+
+    return rebuilt;
+}
+
+size_t SegmentStore::insert(std::string_view text, uint64_t t0, uint64_t t1, int speaker, std::string_view model) {
+    // the segments of the other speakers that start later are few and at the end
+    size_t i = count;
+    for (size_t c = chunks.size(); c > 0; --c) {
+        const auto &entries = chunks[c - 1]->entries;
+
+        size_t j = entries.size();
+        while (j > 0 && entries[j - 1].t0 > t0) {
+            --j;
+            --i;
+        }
+
+        if (j > 0) {
+            break;
+        }
+    }
+
+    const Entry entry = { 0, text.size(), t0, t1, speaker, intern(model) };
+
+    if (i == count && (chunks.empty() || chunks.back()->entries.size() >= SEGMENT_STORE_CHUNK_SIZE)) {
+        chunks.push_back(std::make_shared<Chunk>());
+        chunks.back()->entries.reserve(SEGMENT_STORE_CHUNK_SIZE);
+    }
+
+    const auto [c, j] = locate(i);
+    Chunk &chunk = modify(c);
+
+    chunk.entries.insert(chunk.entries.begin() + j, entry);
+    chunk.entries[j].offset = chunk.text.size();
+    chunk.text.append(text);
+
+    ++count;
+
+    // a chunk segments keep being inserted into, not only appended to, is split
+    if (chunk.entries.size() >= 2*SEGMENT_STORE_CHUNK_SIZE) {
+        const size_t half = chunk.entries.size()/2;
+
+        auto second = rebuild(chunk, half, chunk.entries.size());
+        chunks[c] = rebuild(chunk, 0, half);
+        chunks.insert(chunks.begin() + c + 1, std::move(second));
+    }
+
+    return i;
+}
+
+void SegmentStore::erase(size_t i) {
+    const auto [c, j] = locate(i);
+    Chunk &chunk = modify(c);
+
+    chunk.garbage += chunk.entries[j].length;
+    chunk.entries.erase(chunk.entries.begin() + j);
+
+    --count;
+
+    if (chunk.entries.empty()) {
+        chunks.erase(chunks.begin() + c);
+    } else if (chunk.garbage > std::max<size_t>(chunk.text.size() - chunk.garbage, SEGMENT_STORE_MIN_GARBAGE)) {
+        // replaced partial segments leave their text behind, each byte of it is dropped once
+        chunks[c] = rebuild(chunk, 0, chunk.entries.size());
+    }
+}
+
+void SegmentStore::trim_before(uint64_t t0) {
+    // whole chunks first, then part of the first one that stays
+    while (!chunks.empty() && chunks.front()->entries.back().t0 < t0) {
+        count -= chunks.front()->entries.size();
+        chunks.pop_front();
+    }
+
+    if (chunks.empty()) {
+        return;
+    }
+
+    const auto &entries = chunks.front()->entries;
+    const auto first = std::lower_bound(entries.begin(), entries.end(), t0, [](const Entry &entry, uint64_t t0) {
+        return entry.t0 < t0;
+    }) - entries.begin();
+
+    if (first > 0) {
+        count -= first;
+        chunks.front() = rebuild(*chunks.front(), first, entries.size());
+    }
+}
+
+size_t SegmentStore::find_last(int speaker) const {
+    size_t n = count;
+
+    for (size_t c = chunks.size(); c > 0; --c) {
+        const auto &entries = chunks[c - 1]->entries;
+        n -= entries.size();
+
+        for (size_t j = entries.size(); j > 0; --j) {
+            if (entries[j - 1].speaker == speaker) {
+                return n + j - 1;
+            }
+        }
+    }
+
+    return npos;
+}
+
+void SegmentStore::clear() {
+    chunks.clear();
+    models.reset();
+    count = 0;
+}
+
+std::string SegmentStore::text() const {
+    size_t length = 0;
+    for (const auto &chunk : chunks) {
+        length += chunk->text.size() - chunk->garbage;
+    }
+
+    std::string result;
+    result.reserve(length);
+
+    for (const auto &chunk : chunks) {
+        for (const auto &entry : chunk->entries) {
+            result.append(chunk->text, entry.offset, entry.length);
+        }
+    }
+
+    return result;
+}
+
+uint32_t SegmentStore::intern(std::string_view model) {
+    if (models != nullptr) {
+        for (size_t i = 0; i < models->size(); ++i) {
+            if ((*models)[i] == model) {
+                return i;
+            }
+        }
+    }
+
+    // a new list, copies of the store keep the one they have
+    auto interned = models != nullptr ? std::make_shared<std::vector<std::string>>(*models) : std::make_shared<std::vector<std::string>>();
+    interned->emplace_back(model);
+    models = std::move(interned);
+
+    return models->size() - 1;
+}
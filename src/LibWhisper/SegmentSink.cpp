@@ -0,0 +1,99 @@
+#include <SegmentSink.h>
+
+#include <algorithm>
+#include <vector>
+
+SegmentSubscription::SegmentSubscription(std::shared_ptr<SegmentSink> sink, size_t capacity)
+    : sink(std::move(sink)), capacity(std::max<size_t>(capacity, 1)) {
+    thread = std::jthread([this](std::stop_token stoken) { run(stoken); });
+}
+
+void SegmentSubscription::post(SegmentEvent event) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (backlog.size() >= capacity && !drop_superseded(event)) {
+            backlog.pop_front();
+            ++n_dropped_pending;
+            ++n_dropped_total;
+        }
+
+        backlog.push_back(std::move(event));
+    }
+
+    cv.notify_one();
+}
+
+bool SegmentSubscription::drop_superseded(const SegmentEvent &next) {
+    // from the newest event back: which speakers have a later segment, whether there is a later trim
+    std::vector<char> later_segment;
+    bool later_trim = false;
+
+    auto mark = [&](const SegmentEvent &event) {
+        if (event.kind == SegmentEvent::Trimmed) {
+            later_trim = true;
+            return;
+        }
+
+        const size_t speaker = event.segment.speaker;
+        if (speaker >= later_segment.size()) {
+            later_segment.resize(speaker + 1, false);
+        }
+        later_segment[speaker] = true;
+    };
+
+    auto superseded = [&](const SegmentEvent &event) -> bool {
+        if (event.kind == SegmentEvent::Trimmed) {
+            return later_trim;
+        }
+
+        const size_t speaker = event.segment.speaker;
+        return event.kind == SegmentEvent::Partial && speaker < later_segment.size() && later_segment[speaker];
+    };
+
+    mark(next);
+
+    auto oldest = backlog.end();
+    for (auto it = backlog.end(); it != backlog.begin();) {
+        --it;
+
+        if (superseded(*it)) {
+            oldest = it;
+        }
+
+        mark(*it);
+    }
+
+    if (oldest == backlog.end()) {
+        return false;
+    }
+
+    backlog.erase(oldest);
+    return true;
+}
+
+void SegmentSubscription::run(std::stop_token stoken) {
+    while (true) {
+        SegmentEvent event;
+        uint64_t n_dropped = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!cv.wait(lock, stoken, [this] { return !backlog.empty(); })) {
+                return;
+            }
+
+            event = std::move(backlog.front());
+            backlog.pop_front();
+
+            n_dropped = n_dropped_pending;
+            n_dropped_pending = 0;
+        }
+
+        if (n_dropped > 0) {
+            sink->onOverflow(n_dropped);
+        }
+
+        sink->onSegmentEvent(event);
+    }
+}
@@ -0,0 +1,124 @@
+#include <Transcript.h>
+
+#include <algorithm>
+
+Transcript::Transcript() : m_last(std::make_shared<Block>()) {}
+
+void Transcript::append(std::string_view text, uint64_t t0, uint64_t t1, int speaker) {
+    if (text.empty()) {
+        return;
+    }
+
+    const uint64_t offset = m_last->offset + m_last->text.size();
+
+    if (!m_last->text.empty() && m_last->text.size() + text.size() > TRANSCRIPT_BLOCK_SIZE) {
+        m_full.push_back(std::move(m_last));
+
+        m_last = std::make_shared<Block>();
+        m_last->offset = offset;
+        m_last->text.reserve(TRANSCRIPT_BLOCK_SIZE);
+    } else if (m_last.use_count() > 1) {
+        // a view still holds the last block, it must not see the change
+        m_last = std::make_shared<Block>(*m_last);
+    }
+
+    m_t0_max = std::max(m_t0_max, t0);
+
+    m_last->entries.push_back(Entry { offset, m_t0_max, t1, speaker });
+    m_last->text.append(text);
+
+    ++m_version;
+}
+
+void Transcript::trim_before(uint64_t t0) {
+    // the first segment that stays, the blocks before its block go
+    uint64_t begin = m_last->offset + m_last->text.size();
+
+    auto first_kept = [&](const Block & block) -> bool {
+        const auto it = std::lower_bound(block.entries.begin(), block.entries.end(), t0, [](const Entry & entry, uint64_t t0) {
+            return entry.t0 < t0;
+        });
+
+        if (it == block.entries.end()) {
+            return false;
+        }
+
+        begin = it->offset;
+        return true;
+    };
+
+    while (!m_full.empty() && !first_kept(*m_full.front())) {
+        m_full.pop_front();
+    }
+
+    if (m_full.empty()) {
+        first_kept(*m_last);
+    }
+
+    begin = std::max(begin, m_begin);
+    if (begin != m_begin) {
+        m_begin = begin;
+        ++m_version;
+    }
+}
+
+TranscriptView Transcript::view() const {
+    TranscriptView view;
+
+    view.m_blocks.reserve(m_full.size() + 1);
+    view.m_blocks.insert(view.m_blocks.end(), m_full.begin(), m_full.end());
+    view.m_blocks.push_back(m_last);
+
+    view.m_begin = m_begin;
+    view.m_end = m_last->offset + m_last->text.size();
+    view.m_version = m_version;
+
+    return view;
+}
+
+std::string TranscriptView::text(uint64_t begin, uint64_t end) const {
+    begin = std::clamp(begin, m_begin, m_end);
+    end = std::clamp(end, begin, m_end);
+
+    std::string result;
+    result.reserve(end - begin);
+
+    for (const auto & block : m_blocks) {
+        const uint64_t block_end = block->offset + block->text.size();
+        if (block_end <= begin) {
+            continue;
+        }
+        if (block->offset >= end) {
+            break;
+        }
+
+        const uint64_t from = std::max(begin, block->offset);
+        const uint64_t to = std::min(end, block_end);
+
+        result.append(block->text, from - block->offset, to - from);
+    }
+
+    return result;
+}
+
+std::string TranscriptView::slice(uint64_t t0, uint64_t t1) const {
+    return text(find(t0), find(t1));
+}
+
+uint64_t TranscriptView::find(uint64_t t0) const {
+    // the first block with a segment that does not start before t0
+    const auto block = std::lower_bound(m_blocks.begin(), m_blocks.end(), t0, [](const auto & block, uint64_t t0) {
+        return block->entries.empty() || block->entries.back().t0 < t0;
+    });
+
+    if (block == m_blocks.end()) {
+        return m_end;
+    }
+
+    const auto & entries = (*block)->entries;
+    const auto entry = std::lower_bound(entries.begin(), entries.end(), t0, [](const Transcript::Entry & entry, uint64_t t0) {
+        return entry.t0 < t0;
+    });
+
+    return entry->offset;
+}
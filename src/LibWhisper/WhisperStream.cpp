@@ -1,66 +1,252 @@
 #include <WhisperStream.h>
+
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+struct WhisperStream::State {
+    State (std::string model, std::vector<std::shared_ptr<CaptureDevice>> devices, std::chrono::seconds window, std::string finalModel);
+
+    void task(std::stop_token stoken, int speaker);
+
+    // a partial segment replaces the previous partial one of its speaker, a final one replaces it for good
+    int callback(const stream_segment_t *segment);
+
+    std::mutex contextMutex;
+    std::vector<stream_context_t> contexts;
+    std::mutex segmentsMutex; // the streams call back from their own threads
+    SegmentStore segments;
+    Transcript transcript; // the final segments, trimmed like segments
+    std::vector<char> partial; // per speaker: its last segment is tentative
+    mutable std::mutex snapshotMutex; // only held to copy or swap the pointer, taken after segmentsMutex
+    std::shared_ptr<const SegmentSnapshot> snapshot;
+    std::mutex sinksMutex; // taken after segmentsMutex
+    std::vector<std::pair<uint64_t, std::unique_ptr<SegmentSubscription>>> sinks;
+    uint64_t nextSinkId = 1;
+    std::atomic<int> running = 0;
+    std::atomic_bool alive = true;
+
+    //TODO: replace a string with a URI representation, ideally something accepted into or leveraging the C++ standard library
+    std::string model;
+    std::string finalModel; // empty for no cascade
+    std::vector<std::shared_ptr<CaptureDevice>> devices;
+    std::chrono::seconds window;
+
+    // one per device, declared last so they are stopped before anything they use goes away
+    std::vector<std::jthread> waiters;
+};
+
+WhisperStream::WhisperStream (std::string model, std::shared_ptr<CaptureDevice> device, std::chrono::seconds window, std::string finalModel)
+    : WhisperStream(model, std::vector<std::shared_ptr<CaptureDevice>> { device }, window, finalModel) {}
+
+WhisperStream::WhisperStream (std::string model, std::vector<std::shared_ptr<CaptureDevice>> devices, std::chrono::seconds window, std::string finalModel)
+    : state(std::make_unique<State>(std::move(model), std::move(devices), window, std::move(finalModel))) {}
+
+WhisperStream::WhisperStream (WhisperStream &&other) noexcept = default;
+WhisperStream& WhisperStream::operator= (WhisperStream &&other) noexcept = default;
+
+WhisperStream::~WhisperStream () = default;
+
+std::shared_ptr<const SegmentSnapshot> WhisperStream::getSnapshot() const {
+    std::lock_guard<std::mutex> lock(state->snapshotMutex);
+
+    return state->snapshot;
+}
+
+uint64_t WhisperStream::subscribe(std::shared_ptr<SegmentSink> sink, size_t backlog) {
+    std::lock_guard<std::mutex> lock(state->sinksMutex);
+
+    const uint64_t id = state->nextSinkId++;
+    state->sinks.emplace_back(id, std::make_unique<SegmentSubscription>(std::move(sink), backlog));
+
+    return id;
+}
+
+void WhisperStream::unsubscribe(uint64_t id) {
+    std::unique_ptr<SegmentSubscription> subscription;
+
+    {
+        std::lock_guard<std::mutex> lock(state->sinksMutex);
 
-std::string to_string(OrderedSegments segments) {
-    std::string result;
-    for (const auto &segment : segments) {
-        result += segment.text;
+        auto & sinks = state->sinks;
+
+        const auto it = std::find_if(sinks.begin(), sinks.end(), [id](const auto &sink) { return sink.first == id; });
+        if (it == sinks.end()) {
+            return;
+        }
+
+        subscription = std::move(it->second);
+        sinks.erase(it);
     }
-    return result;
+
+    // joined outside the lock, so the streams do not wait for the sink to finish its event
+    subscription.reset();
+}
+
+SegmentStore& WhisperStream::getSegments() {
+    return state->segments;
+}
+
+bool WhisperStream::isAlive() const {
+    return state->alive;
+}
+
+stream_stats_t WhisperStream::getStats(int speaker) {
+    stream_stats_t stats {};
+
+    std::lock_guard<std::mutex> lock(state->contextMutex);
+
+    const auto & contexts = state->contexts;
+    if (speaker >= 0 && speaker < (int) contexts.size() && contexts[speaker] != nullptr) {
+        stream_get_stats(contexts[speaker], &stats);
+    }
+
+    return stats;
 }
 
-WhisperStream::WhisperStream (std::string model, std::shared_ptr<CaptureDevice> device, std::chrono::seconds window) {
+WhisperStream::State::State (std::string model, std::vector<std::shared_ptr<CaptureDevice>> devices, std::chrono::seconds window, std::string finalModel) {
     this->model = model;
-    this->device = device;
+    this->finalModel = finalModel;
+    this->devices = devices;
     this->window = window;
 
-    waiter = std::jthread(std::bind(&WhisperStream::task, this, std::placeholders::_1));
+    snapshot = std::make_shared<const SegmentSnapshot>();
+
+    contexts.resize(this->devices.size(), nullptr);
+    partial.resize(this->devices.size(), false);
+    running = this->devices.size();
+
+    for (size_t i = 0; i < this->devices.size(); ++i) {
+        waiters.emplace_back(std::bind(&State::task, this, std::placeholders::_1, (int) i));
+    }
 }
 
-void WhisperStream::task(std::stop_token stoken) {
+void WhisperStream::State::task(std::stop_token stoken, int speaker) {
+    const auto & device = devices[speaker];
+
     auto params = stream_default_params();
     params.model = model.c_str();
+    params.final_model = finalModel.empty() ? NULL : finalModel.c_str();
+    params.incremental = true;
+    params.speaker = speaker;
+
+    // with several speakers, each one is mostly quiet while the others talk
+    params.vad_gate = devices.size() > 1;
 
     if (device != nullptr) {
         params.capture_id = device->id;
+        params.channel = device->channel;
+
+        if (!device->path.empty()) {
+            params.source = device->path.c_str();
+            params.source_speed = device->speed;
+        }
     }
 
     auto ctx = stream_init(params);
-    if (ctx == nullptr) {
-        return;
-    }
+    if (ctx != nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(contextMutex);
+            contexts[speaker] = ctx;
+        }
 
-    auto callbackFn = +[](const char *text, int64_t t0, int64_t t1, void *ctx) -> int {
-        return static_cast<WhisperStream*>(ctx)->callback(std::string(text), t0, t1, static_cast<WhisperStream *>(ctx));
-    };
+        auto callbackFn = +[](const stream_segment_t *segment, void *ctx) -> int {
+            return static_cast<State*>(ctx)->callback(segment);
+        };
 
-    while (!stoken.stop_requested()) {
-        auto errVal = stream_run(ctx, this, callbackFn);
+        while (!stoken.stop_requested()) {
+            auto errVal = stream_run_segments(ctx, this, callbackFn);
 
-        if (errVal != 0) {
-            break;
+            if (errVal != 0) {
+                break;
+            }
         }
+
+        {
+            std::lock_guard<std::mutex> lock(contextMutex);
+            contexts[speaker] = nullptr;
+        }
+
+        stream_free(ctx);
     }
 
-    stream_free(ctx);
-    alive = false;
+    if (--running == 0) {
+        alive = false;
+    }
 }
 
-int WhisperStream::callback( std::string text, int64_t t0, int64_t t1, WhisperStream *ctx) {
-    if (segments.empty() || text.empty()) {
-        segments.push_back(Segment("", -1, -1));
+int WhisperStream::State::callback(const stream_segment_t *segment) {
+    std::lock_guard<std::mutex> lock(segmentsMutex);
+
+    const int speaker = segment->speaker;
+
+    std::vector<SegmentEvent> events;
+
+    // the partial segment of a speaker is the last one of theirs, other speakers may have added some since
+    const bool withdrawn = partial[speaker];
+    if (withdrawn) {
+        if (const size_t i = segments.find_last(speaker); i != SegmentStore::npos) {
+            segments.erase(i);
+        }
+        partial[speaker] = false;
     }
 
-    segments[segments.size() - 1] = Segment(text, t0, t1);
+    if (segment->text[0] != '\0') {
+        // in time order across the speakers, which for a single one is always the end
+        segments.insert(segment->text, segment->t0, segment->t1, speaker, segment->model);
+
+        partial[speaker] = segment->kind == STREAM_SEGMENT_PARTIAL;
+
+        if (!partial[speaker]) {
+            transcript.append(segment->text, segment->t0, segment->t1, speaker);
+        }
+
+        events.push_back(SegmentEvent { partial[speaker] ? SegmentEvent::Partial : SegmentEvent::Final, Segment { segment->text, (uint64_t) segment->t0, (uint64_t) segment->t1, speaker, segment->model } });
+    } else if (withdrawn) {
+        events.push_back(SegmentEvent { SegmentEvent::Partial, Segment { "", (uint64_t) segment->t0, (uint64_t) segment->t1, speaker, segment->model } });
+    }
+
+    if (!segments.empty()) {
+        // keep the segments that start within window of the last one
+        const uint64_t t0_last = segments.back().t0;
+        const uint64_t t0_window = std::chrono::milliseconds(window).count();
+
+        if (t0_last > t0_window) {
+            const size_t n_segments = segments.size();
+
+            segments.trim_before(t0_last - t0_window);
+            transcript.trim_before(t0_last - t0_window);
+
+            if (segments.size() != n_segments) {
+                events.push_back(SegmentEvent { SegmentEvent::Trimmed, Segment { "", t0_last - t0_window, t0_last - t0_window, speaker, {} } });
+            }
+        }
+    }
+
+    // the store and the transcript share their chunks with the snapshot, only a few pointers are copied
+    const uint64_t version = snapshot->version + 1;
+    auto next = std::make_shared<const SegmentSnapshot>(SegmentSnapshot { version, segments, transcript.view() });
+
+    {
+        std::lock_guard<std::mutex> snapshotLock(snapshotMutex);
+        snapshot.swap(next);
+    }
+
+    // still under segmentsMutex, so every sink sees the changes of all speakers in snapshot order
+    if (!events.empty()) {
+        std::lock_guard<std::mutex> sinksLock(sinksMutex);
+
+        for (auto & event : events) {
+            event.version = version;
 
-    size_t k = 0;
-    for (auto segment : segments) {
-        auto last = segments.back();
-        if (std::chrono::milliseconds(last.t0 - segment.t0) > window) {
-            k += 1;
+            for (const auto & [id, subscription] : sinks) {
+                subscription->post(event);
+            }
         }
     }
 
-    segments.erase(segments.begin(), segments.begin() + k);
     return 0;
 }
@@ -0,0 +1,98 @@
+#include "audio_ring.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+void audio_ring::view::copy(float * dst) const {
+    // dst may be null for an empty view, which memcpy does not allow even for no bytes
+    if (!first.empty()) {
+        memcpy(dst, first.data(), first.size() * sizeof(float));
+    }
+    if (!second.empty()) {
+        memcpy(dst + first.size(), second.data(), second.size() * sizeof(float));
+    }
+}
+
+audio_ring::audio_ring(size_t n_samples) {
+    m_data.resize(std::bit_ceil(std::max<size_t>(n_samples, 1)));
+    m_mask = m_data.size() - 1;
+}
+
+void audio_ring::write(const float * data, size_t n_samples) {
+    const uint64_t end = m_head.load(std::memory_order_relaxed) + n_samples;
+
+    // only the newest capacity() samples can be kept, the others still count
+    if (n_samples > m_data.size()) {
+        data     += n_samples - m_data.size();
+        n_samples = m_data.size();
+    }
+
+    const uint64_t pos = end - n_samples;
+    const size_t   off = pos & m_mask;
+    const size_t   n0  = std::min(n_samples, m_data.size() - off);
+
+    // announce the block before touching the samples, pairs with the fence in n_overwritten()
+    m_reserved.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&m_data[off], data, n0 * sizeof(float));
+    memcpy(&m_data[0], data + n0, (n_samples - n0) * sizeof(float));
+
+    // publish the samples to the consumers
+    m_head.store(end, std::memory_order_release);
+}
+
+audio_ring::view audio_ring::read(cursor & c, size_t max_samples) const {
+    const uint64_t end = head();
+
+    if (end - c.pos > m_data.size()) {
+        c.n_lost += end - c.pos - m_data.size();
+        c.pos     = end - m_data.size();
+    }
+
+    return make_view(c.pos, c.pos + std::min<uint64_t>(end - c.pos, max_samples));
+}
+
+audio_ring::view audio_ring::range(uint64_t begin, uint64_t end) const {
+    const uint64_t h      = head();
+    const uint64_t oldest = h > m_data.size() ? h - m_data.size() : 0;
+
+    // a range that is gone completely comes back empty
+    end   = std::min(end, h);
+    begin = std::clamp(begin, std::min(oldest, end), end);
+
+    return make_view(begin, end);
+}
+
+audio_ring::view audio_ring::latest(size_t n_samples) const {
+    const uint64_t h = head();
+
+    return range(h - std::min<uint64_t>(h, n_samples), h);
+}
+
+size_t audio_ring::n_overwritten(const view & v) const {
+    // a reader that saw any sample of a block also sees the block's reservation
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const uint64_t reserved = m_reserved.load(std::memory_order_relaxed);
+    if (reserved - v.begin <= m_data.size()) {
+        return 0;
+    }
+
+    return std::min<uint64_t>(v.size(), reserved - m_data.size() - v.begin);
+}
+
+audio_ring::view audio_ring::make_view(uint64_t begin, uint64_t end) const {
+    view v;
+    v.begin = begin;
+
+    const size_t n   = end - begin;
+    const size_t off = begin & m_mask;
+    const size_t n0  = std::min(n, m_data.size() - off);
+
+    v.first  = std::span<const float>(m_data.data() + off, n0);
+    v.second = std::span<const float>(m_data.data(), n - n0);
+
+    return v;
+}
@@ -0,0 +1,68 @@
+#include "audio_window.h"
+
+#include <algorithm>
+#include <cstring>
+
+audio_window::audio_window(size_t n_capacity) : m_data(n_capacity) {}
+
+void audio_window::push(const audio_ring::view & audio, size_t n_max) {
+    const size_t n_new = audio.size();
+
+    // drop what will fall out of the window first, so there is less to move
+    keep(std::max(n_max, n_new) - n_new);
+
+    reserve_tail(n_new);
+
+    audio.copy(m_data.data() + m_tail);
+    m_tail += n_new;
+    m_end = audio.end();
+}
+
+uint64_t audio_window::slide(const audio_ring & ring, uint64_t begin, uint64_t end) {
+    // what the window has can only be kept if the range continues it
+    if (empty() || begin < this->begin() || begin > m_end || end < m_end) {
+        clear();
+        m_end = begin;
+    }
+
+    keep(m_end - begin);
+
+    const auto audio = ring.range(m_end, end);
+    if (audio.begin != m_end) {
+        // the ring lapped the window, start over from what it still has
+        clear();
+    }
+
+    push(audio, size() + audio.size());
+
+    // the samples the producer got to while they were copied are gone as well
+    const size_t n_overwritten = ring.n_overwritten(audio);
+    if (n_overwritten > 0) {
+        keep(m_end - (audio.begin + n_overwritten));
+    }
+
+    return this->begin();
+}
+
+void audio_window::keep(size_t n) {
+    if (size() > n) {
+        m_head = m_tail - n;
+    }
+}
+
+void audio_window::reserve_tail(size_t n) {
+    if (m_tail + n <= m_data.size()) {
+        return;
+    }
+
+    const size_t n_cur = size();
+
+    if (n_cur + n > m_data.size()) {
+        m_data.resize(2*(n_cur + n));
+    }
+
+    memmove(m_data.data(), m_data.data() + m_head, n_cur * sizeof(float));
+
+    m_head = 0;
+    m_tail = n_cur;
+}
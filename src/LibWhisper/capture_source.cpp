@@ -0,0 +1,127 @@
+#include "capture_source.h"
+
+#include <chrono>
+#include <cstdio>
+
+// the replay delivers audio in blocks of this length, about what a capture device does
+#define FILE_CAPTURE_BLOCK_MS 10
+
+file_capture_source::file_capture_source(std::string path, float speed, int channel) : m_path(std::move(path)), m_speed(speed), m_channel(channel) {}
+
+bool file_capture_source::open(int sample_rate, capture_sink * sink) {
+    if (!m_reader.open(m_path)) {
+        return false;
+    }
+
+    if (m_reader.sample_rate() != sample_rate) {
+        fprintf(stderr, "%s: resampling '%s' from %d Hz to %d Hz\n", __func__, m_path.c_str(), m_reader.sample_rate(), sample_rate);
+        m_reader.set_sample_rate(sample_rate);
+    }
+
+    if (m_channel >= 0 && m_reader.channels() != 2) {
+        fprintf(stderr, "%s: WAV file '%s' must be stereo to replay channel %d\n", __func__, m_path.c_str(), m_channel);
+        m_reader.close();
+        return false;
+    }
+
+    if (m_speed > 0.0f) {
+        fprintf(stderr, "%s: replaying '%s' at %.2fx real time\n", __func__, m_path.c_str(), m_speed);
+    } else {
+        fprintf(stderr, "%s: replaying '%s' as fast as it is read\n", __func__, m_path.c_str());
+    }
+
+    m_sample_rate = sample_rate;
+    m_sink = sink;
+
+    m_thread = std::jthread([this](std::stop_token stoken) { run(stoken); });
+
+    return true;
+}
+
+bool file_capture_source::resume() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+    }
+
+    m_cv.notify_all();
+
+    return true;
+}
+
+bool file_capture_source::pause() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+
+    return true;
+}
+
+void file_capture_source::run(std::stop_token stoken) {
+    using clock = std::chrono::steady_clock;
+
+    const size_t n_block = (m_sample_rate * FILE_CAPTURE_BLOCK_MS) / 1000;
+
+    std::vector<float> block(n_block);
+
+    // both sides of a stereo recording, when only one of them is replayed
+    std::vector<float> left;
+    std::vector<float> right;
+    if (m_channel >= 0) {
+        left.resize(n_block);
+        right.resize(n_block);
+    }
+
+    // pacing restarts from every resume
+    clock::time_point t_start;
+    uint64_t n_sent = 0;
+    uint64_t n_total = 0;
+    bool running = false;
+
+    while (!stoken.stop_requested()) {
+        if (!running) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_cv.wait(lock, stoken, [&] { return m_running; })) {
+                break;
+            }
+
+            running = true;
+            t_start = clock::now();
+            n_sent = 0;
+        }
+
+        if (m_speed > 0.0f) {
+            const auto t_due = t_start + std::chrono::duration<double>(n_sent / (m_sample_rate * (double) m_speed));
+            std::this_thread::sleep_until(std::chrono::time_point_cast<clock::duration>(t_due));
+        } else {
+            // as fast as possible, but not faster than the reader
+            while (m_sink->space() < n_block && !stoken.stop_requested()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            running = m_running;
+        }
+
+        if (!running) {
+            continue;
+        }
+
+        const size_t n = m_channel >= 0 ?
+            m_reader.read(block.data(), left.data(), right.data(), n_block) :
+            m_reader.read(block.data(), n_block);
+
+        if (n > 0) {
+            m_sink->write(m_channel < 0 ? block.data() : m_channel == 0 ? left.data() : right.data(), n);
+            n_sent += n;
+            n_total += n;
+        }
+
+        if (n < n_block) {
+            fprintf(stderr, "%s: end of '%s' after %.1f s\n", __func__, m_path.c_str(), (double) n_total / m_sample_rate);
+            m_finished = true;
+            break;
+        }
+    }
+}
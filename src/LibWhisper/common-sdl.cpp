@@ -0,0 +1,339 @@
+// This code is based on the SDL helpers provided with whisper.cpp, ported to the SDL3 audio stream API:
+// https://github.com/ggerganov/whisper.cpp/blob/ca21f7ab16694384fb74b1ba4f68b39f16540d23/examples/common-sdl.cpp
+
+#include "common-sdl.h"
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+sdl_capture_source::sdl_capture_source(int capture_id, int channel) : m_capture_id(capture_id), m_channel(channel) {}
+
+sdl_capture_source::~sdl_capture_source() {
+    if (m_stream) {
+        SDL_DestroyAudioStream(m_stream);
+    }
+}
+
+bool sdl_capture_source::open(int sample_rate, capture_sink * sink) {
+    if (!SDL_Init(SDL_INIT_AUDIO)) {
+        fprintf(stderr, "%s: couldn't initialize SDL: %s\n", __func__, SDL_GetError());
+        return false;
+    }
+
+    SDL_SetHint(SDL_HINT_AUDIO_RESAMPLING_MODE, "medium");
+
+    m_dev_id_in = SDL_AUDIO_DEVICE_DEFAULT_RECORDING;
+
+    {
+        int n_devices = 0;
+        SDL_AudioDeviceID *devices = SDL_GetAudioRecordingDevices(&n_devices);
+
+        fprintf(stderr, "%s: found %d capture devices:\n", __func__, n_devices);
+        for (int i = 0; i < n_devices; i++) {
+            fprintf(stderr, "%s:    - Capture device #%d: '%s'\n", __func__, i, SDL_GetAudioDeviceName(devices[i]));
+        }
+
+        // capture ids are indices into the recording device list, see CaptureDevice::get_devices()
+        if (m_capture_id >= 0 && m_capture_id < n_devices) {
+            m_dev_id_in = devices[m_capture_id];
+        }
+
+        SDL_free(devices);
+    }
+
+    // the device's own rate, converting it here is both faster and better than SDL's resampling
+    SDL_AudioSpec device_spec{};
+    if (!SDL_GetAudioDeviceFormat(m_dev_id_in, &device_spec, nullptr) || device_spec.freq <= 0) {
+        device_spec.freq = sample_rate;
+    }
+
+    SDL_AudioSpec capture_spec{};
+
+    capture_spec.freq     = device_spec.freq;
+    capture_spec.format   = SDL_AUDIO_F32;
+    capture_spec.channels = m_channel >= 0 ? 2 : 1;
+
+    auto stream_callback = +[](void *userdata, SDL_AudioStream *stream, int additional_amount, int /*total_amount*/) {
+        sdl_capture_source *source = static_cast<sdl_capture_source *>(userdata);
+
+        while (additional_amount > 0) {
+            float buf[1024];
+
+            const int n = SDL_GetAudioStreamData(stream, buf, std::min<int>(additional_amount, sizeof(buf)));
+            if (n <= 0) {
+                break;
+            }
+
+            source->deliver(buf, n / sizeof(float));
+            additional_amount -= n;
+        }
+    };
+
+    fprintf(stderr, "%s: attempt to open %s capture device ...\n", __func__, m_capture_id >= 0 ? SDL_GetAudioDeviceName(m_dev_id_in) : "default");
+
+    m_sink = sink;
+    m_resampler = resampler(capture_spec.freq, sample_rate);
+    m_resampled.resize(m_resampler.max_output(1024));
+
+    m_stream = SDL_OpenAudioDeviceStream(m_dev_id_in, &capture_spec, stream_callback, this);
+    if (!m_stream) {
+        fprintf(stderr, "%s: couldn't open an audio device for capture: %s!\n", __func__, SDL_GetError());
+        m_dev_id_in = 0;
+        return false;
+    }
+
+    fprintf(stderr, "%s: opened capture device: \n", __func__);
+    fprintf(stderr, "%s:     sample rate:    %d (resampled to %d)\n", __func__, capture_spec.freq, sample_rate);
+    fprintf(stderr, "%s:     format:         %d (required: %d)\n", __func__, capture_spec.format, SDL_AUDIO_F32);
+    fprintf(stderr, "%s:     channels:       %d (transcribing %s)\n", __func__, capture_spec.channels, m_channel >= 0 ? (m_channel == 0 ? "left" : "right") : "all");
+
+    m_sample_rate = sample_rate;
+
+    return true;
+}
+
+void sdl_capture_source::deliver(const float * data, size_t n_samples) {
+    if (m_channel >= 0) {
+        // deinterleave the picked channel, the buffer only grows like the one below
+        const size_t n_frames = n_samples/2;
+        m_picked.resize(std::max(m_picked.size(), n_frames));
+
+        for (size_t i = 0; i < n_frames; i++) {
+            m_picked[i] = data[2*i + m_channel];
+        }
+
+        data = m_picked.data();
+        n_samples = n_frames;
+    }
+
+    if (m_resampler.passthrough()) {
+        m_sink->write(data, n_samples);
+        return;
+    }
+
+    // only grows when SDL hands over a larger block than any before
+    m_resampled.resize(std::max(m_resampled.size(), m_resampler.max_output(n_samples)));
+
+    m_sink->write(m_resampled.data(), m_resampler.process(data, n_samples, m_resampled.data()));
+}
+
+bool sdl_capture_source::resume() {
+    return SDL_ResumeAudioStreamDevice(m_stream);
+}
+
+bool sdl_capture_source::pause() {
+    return SDL_PauseAudioStreamDevice(m_stream);
+}
+
+audio_async::audio_async(int len_ms) {
+    m_len_ms = len_ms;
+
+    m_running = false;
+}
+
+audio_async::~audio_async() {
+    // stop the source before the ring it writes to goes away
+    m_source.reset();
+}
+
+bool audio_async::init(int capture_id, int sample_rate) {
+    return init(std::make_unique<sdl_capture_source>(capture_id), sample_rate);
+}
+
+bool audio_async::init(std::unique_ptr<capture_source> source, int sample_rate) {
+    if (!source->open(sample_rate, this)) {
+        return false;
+    }
+
+    m_source = std::move(source);
+    m_sample_rate = m_source->sample_rate();
+
+    // twice the requested length, so readers can lag behind a full window before they get lapped
+    m_ring = std::make_unique<audio_ring>(2*(m_sample_rate*m_len_ms)/1000);
+
+    return true;
+}
+
+bool audio_async::resume() {
+    if (!m_source) {
+        fprintf(stderr, "%s: no audio device to resume!\n", __func__);
+        return false;
+    }
+
+    if (m_running) {
+        fprintf(stderr, "%s: already running!\n", __func__);
+        return false;
+    }
+
+    m_running = true;
+
+    if (!m_source->resume()) {
+        m_running = false;
+        return false;
+    }
+
+    return true;
+}
+
+bool audio_async::pause() {
+    if (!m_source) {
+        fprintf(stderr, "%s: no audio device to pause!\n", __func__);
+        return false;
+    }
+
+    if (!m_running) {
+        fprintf(stderr, "%s: already paused!\n", __func__);
+        return false;
+    }
+
+    m_source->pause();
+
+    m_running = false;
+
+    return true;
+}
+
+bool audio_async::clear() {
+    if (!m_source) {
+        fprintf(stderr, "%s: no audio device to clear!\n", __func__);
+        return false;
+    }
+
+    if (!m_running) {
+        fprintf(stderr, "%s: not running!\n", __func__);
+        return false;
+    }
+
+    m_clear_pos = m_ring->head();
+
+    return true;
+}
+
+// callback to be called by SDL
+void audio_async::callback(uint8_t * stream, int len) {
+    write(reinterpret_cast<const float *>(stream), len / sizeof(float));
+}
+
+void audio_async::set_capture_cpus(std::vector<int> cpus) {
+    m_capture_cpus = std::move(cpus);
+    m_pin_pending = !m_capture_cpus.empty();
+}
+
+void audio_async::write(const float * data, size_t n_samples) {
+    if (!m_running) {
+        return;
+    }
+
+    // the source's thread is not ours to create, so it is pinned from inside
+    if (m_pin_pending.load(std::memory_order_relaxed) && m_pin_pending.exchange(false)) {
+        cpu_pin_thread(m_capture_cpus);
+    }
+
+    m_ring->write(data, n_samples);
+
+    // pairs with the fence in wait(): either the consumer sees the new head or we see its request
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // once per step at most, when a consumer waits for this much: passing through
+    // m_mutex makes sure it is either asleep already or sees the new head when it
+    // checks, so the wakeup is not lost, which matters for the last block of a
+    // file source that writes nothing after it
+    if (m_ring->head() >= m_notify_at.load(std::memory_order_relaxed)) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_cv.notify_all();
+    }
+}
+
+void audio_async::get(int ms, std::vector<float> & result) {
+    if (!m_source) {
+        fprintf(stderr, "%s: no audio device to get audio from!\n", __func__);
+        return;
+    }
+
+    if (!m_running) {
+        fprintf(stderr, "%s: not running!\n", __func__);
+        return;
+    }
+
+    result.clear();
+
+    if (ms <= 0) {
+        ms = m_len_ms;
+    }
+
+    size_t n_samples = (m_sample_rate * ms) / 1000;
+    n_samples = std::min<size_t>(n_samples, (m_sample_rate * m_len_ms) / 1000);
+    n_samples = std::min<size_t>(n_samples, m_ring->head() - m_clear_pos);
+
+    const auto audio = m_ring->latest(n_samples);
+
+    result.resize(audio.size());
+    audio.copy(result.data());
+}
+
+bool audio_async::wait(size_t n_samples, int timeout_ms) {
+    return wait(audio_ring::cursor { m_clear_pos, 0 }, n_samples, timeout_ms);
+}
+
+bool audio_async::wait(const audio_ring::cursor & cursor, size_t n_samples, int timeout_ms) {
+    if (!m_source || !m_running) {
+        return false;
+    }
+
+    const uint64_t target = cursor.pos + n_samples;
+
+    m_notify_at.store(target, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool ready = m_ring->head() >= target;
+    if (!ready) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        ready = m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+            return m_ring->head() >= target;
+        });
+    }
+
+    m_notify_at.store(UINT64_MAX, std::memory_order_relaxed);
+
+    return ready;
+}
+
+size_t audio_async::space() const {
+    // keep len_ms behind the reader, which may still look back at it, and what is held
+    const uint64_t pos = std::min(m_read_pos.load(std::memory_order_relaxed), m_hold_pos.load(std::memory_order_relaxed));
+    const uint64_t n_used = m_ring->head() - pos + (m_sample_rate*m_len_ms)/1000;
+
+    return n_used < m_ring->capacity() ? m_ring->capacity() - n_used : 0;
+}
+
+audio_ring::view audio_async::read(audio_ring::cursor & cursor, size_t max_samples) {
+    const auto audio = m_ring->read(cursor, max_samples);
+    m_read_pos.store(audio.begin, std::memory_order_relaxed);
+
+    return audio;
+}
+
+size_t audio_async::available() {
+    return m_ring->head() - m_clear_pos;
+}
+
+bool sdl_poll_events() {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        switch (event.type) {
+            case SDL_EVENT_QUIT:
+                {
+                    return false;
+                } break;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
@@ -1,6 +1,8 @@
 #define _USE_MATH_DEFINES // for M_PI
 
 #include "common.h"
+#include "dsp.h"
+#include "wav_reader.h"
 
 // third-party utilities
 // use your favorite implementations
@@ -19,16 +21,6 @@
 #pragma warning(disable: 4244 4267) // possible loss of data
 #endif
 
-#ifdef _WIN32
-#include <fcntl.h>
-#include <io.h>
-#endif
-
-#ifdef WHISPER_FFMPEG
-// as implemented in ffmpeg_trancode.cpp only embedded in common lib if whisper built with ffmpeg support
-extern bool ffmpeg_decode_audio(const std::string & ifname, std::vector<uint8_t> & wav_data);
-#endif
-
 // Function to check if the next argument exists
 static std::string get_next_arg(int& i, int argc, char** argv, const std::string& flag, gpt_params& params) {
     if (i + 1 < argc && argv[i + 1][0] != '-') {
@@ -640,110 +632,70 @@ bool is_wav_buffer(const std::string buf) {
 }
 
 bool read_wav(const std::string & fname, std::vector<float>& pcmf32, std::vector<std::vector<float>>& pcmf32s, bool stereo) {
-    drwav wav;
-    std::vector<uint8_t> wav_data; // used for pipe input from stdin or ffmpeg decoding output
-
-    if (fname == "-") {
-        {
-            #ifdef _WIN32
-            _setmode(_fileno(stdin), _O_BINARY);
-            #endif
-
-            uint8_t buf[1024];
-            while (true)
-            {
-                const size_t n = fread(buf, 1, sizeof(buf), stdin);
-                if (n == 0) {
-                    break;
-                }
-                wav_data.insert(wav_data.end(), buf, buf + n);
-            }
-        }
-
-        if (drwav_init_memory(&wav, wav_data.data(), wav_data.size(), nullptr) == false) {
-            fprintf(stderr, "error: failed to open WAV file from stdin\n");
-            return false;
-        }
-
-        fprintf(stderr, "%s: read %zu bytes from stdin\n", __func__, wav_data.size());
-    }
-    else if (is_wav_buffer(fname)) {
-        if (drwav_init_memory(&wav, fname.c_str(), fname.size(), nullptr) == false) {
-            fprintf(stderr, "error: failed to open WAV file from fname buffer\n");
-            return false;
-        }
-    }
-    else if (drwav_init_file(&wav, fname.c_str(), nullptr) == false) {
-#if defined(WHISPER_FFMPEG)
-        if (ffmpeg_decode_audio(fname, wav_data) != 0) {
-            fprintf(stderr, "error: failed to ffmpeg decode '%s' \n", fname.c_str());
-            return false;
-        }
-        if (drwav_init_memory(&wav, wav_data.data(), wav_data.size(), nullptr) == false) {
-            fprintf(stderr, "error: failed to read wav data as wav \n");
-            return false;
-        }
-#else
-        fprintf(stderr, "error: failed to open '%s' as WAV file\n", fname.c_str());
-        return false;
-#endif
-    }
+    wav_reader wav;
 
-    if (wav.channels != 1 && wav.channels != 2) {
-        fprintf(stderr, "%s: WAV file '%s' must be mono or stereo\n", __func__, fname.c_str());
-        drwav_uninit(&wav);
+    if (!wav.open(fname)) {
         return false;
     }
 
-    if (stereo && wav.channels != 2) {
+    if (stereo && wav.channels() != 2) {
         fprintf(stderr, "%s: WAV file '%s' must be stereo for diarization\n", __func__, fname.c_str());
-        drwav_uninit(&wav);
         return false;
     }
 
-    if (wav.sampleRate != COMMON_SAMPLE_RATE) {
-        fprintf(stderr, "%s: WAV file '%s' must be %i kHz\n", __func__, fname.c_str(), COMMON_SAMPLE_RATE/1000);
-        drwav_uninit(&wav);
-        return false;
+    if (wav.sample_rate() != COMMON_SAMPLE_RATE) {
+        fprintf(stderr, "%s: resampling '%s' from %d Hz to %d Hz\n", __func__, fname.c_str(), wav.sample_rate(), COMMON_SAMPLE_RATE);
+        wav.set_sample_rate(COMMON_SAMPLE_RATE);
     }
 
-    if (wav.bitsPerSample != 16) {
+    if (wav.bits_per_sample() != 16) {
         fprintf(stderr, "%s: WAV file '%s' must be 16-bit\n", __func__, fname.c_str());
-        drwav_uninit(&wav);
         return false;
     }
 
-    const uint64_t n = wav_data.empty() ? wav.totalPCMFrameCount : wav_data.size()/(wav.channels*wav.bitsPerSample/8);
-
-    std::vector<int16_t> pcm16;
-    pcm16.resize(n*wav.channels);
-    drwav_read_pcm_frames_s16(&wav, n, pcm16.data());
-    drwav_uninit(&wav);
+    // decode straight into the float buffers, one second at a time
+    const size_t n_block = COMMON_SAMPLE_RATE;
 
-    // convert to mono, float
-    pcmf32.resize(n);
-    if (wav.channels == 1) {
-        for (uint64_t i = 0; i < n; i++) {
-            pcmf32[i] = float(pcm16[i])/32768.0f;
-        }
-    } else {
-        for (uint64_t i = 0; i < n; i++) {
-            pcmf32[i] = float(pcm16[2*i] + pcm16[2*i + 1])/65536.0f;
-        }
-    }
+    pcmf32.clear();
+    pcmf32.reserve(wav.n_frames());
 
     if (stereo) {
-        // convert to stereo, float
         pcmf32s.resize(2);
+        pcmf32s[0].clear();
+        pcmf32s[1].clear();
+        pcmf32s[0].reserve(wav.n_frames());
+        pcmf32s[1].reserve(wav.n_frames());
+    }
+
+    while (true) {
+        const size_t n = pcmf32.size();
+
+        pcmf32.resize(n + n_block);
+
+        size_t n_read = 0;
+        if (stereo) {
+            pcmf32s[0].resize(n + n_block);
+            pcmf32s[1].resize(n + n_block);
+
+            n_read = wav.read(pcmf32.data() + n, pcmf32s[0].data() + n, pcmf32s[1].data() + n, n_block);
 
-        pcmf32s[0].resize(n);
-        pcmf32s[1].resize(n);
-        for (uint64_t i = 0; i < n; i++) {
-            pcmf32s[0][i] = float(pcm16[2*i])/32768.0f;
-            pcmf32s[1][i] = float(pcm16[2*i + 1])/32768.0f;
+            pcmf32s[0].resize(n + n_read);
+            pcmf32s[1].resize(n + n_read);
+        } else {
+            n_read = wav.read(pcmf32.data() + n, n_block);
+        }
+
+        pcmf32.resize(n + n_read);
+
+        if (n_read < n_block) {
+            break;
         }
     }
 
+    if (fname == "-") {
+        fprintf(stderr, "%s: read %zu samples from stdin\n", __func__, pcmf32.size());
+    }
+
     return true;
 }
 
@@ -752,12 +704,11 @@ void high_pass_filter(std::vector<float> & data, float cutoff, float sample_rate
     const float dt = 1.0f / sample_rate;
     const float alpha = dt / (rc + dt);
 
-    float y = data[0];
-
-    for (size_t i = 1; i < data.size(); i++) {
-        y = alpha * (y + data[i] - data[i - 1]);
-        data[i] = y;
+    if (data.size() < 2) {
+        return;
     }
+
+    dsp_get_kernels().high_pass(data.data() + 1, data.size() - 1, alpha, data[0]);
 }
 
 bool vad_simple(std::vector<float> & pcmf32, int sample_rate, int last_ms, float vad_thold, float freq_thold, bool verbose) {
@@ -773,16 +724,10 @@ bool vad_simple(std::vector<float> & pcmf32, int sample_rate, int last_ms, float
         high_pass_filter(pcmf32, freq_thold, sample_rate);
     }
 
-    float energy_all  = 0.0f;
-    float energy_last = 0.0f;
+    const auto & dsp = dsp_get_kernels();
 
-    for (int i = 0; i < n_samples; i++) {
-        energy_all += fabsf(pcmf32[i]);
-
-        if (i >= n_samples - n_samples_last) {
-            energy_last += fabsf(pcmf32[i]);
-        }
-    }
+    float energy_last = dsp.sum_abs(pcmf32.data() + n_samples - n_samples_last, n_samples_last);
+    float energy_all  = dsp.sum_abs(pcmf32.data(), n_samples - n_samples_last) + energy_last;
 
     energy_all  /= n_samples;
     energy_last /= n_samples_last;
@@ -0,0 +1,206 @@
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// first line of a sysfs file, empty if it cannot be read
+static std::string cpu_read(const std::string & path) {
+    std::ifstream fin(path);
+
+    std::string line;
+    std::getline(fin, line);
+
+    return line;
+}
+
+static int cpu_read_int(const std::string & path, int fallback) {
+    const std::string line = cpu_read(path);
+
+    try {
+        return line.empty() ? fallback : std::stoi(line);
+    } catch (const std::exception &) {
+        return fallback;
+    }
+}
+
+// a kernel CPU list, like "0-3,8,10-11"
+static std::vector<int> cpu_parse_list(const std::string & list) {
+    std::vector<int> cpus;
+
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+
+        int first = 0;
+        int last  = 0;
+        const std::string range = list.substr(pos, end - pos);
+
+        if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } else if (sscanf(range.c_str(), "%d", &first) == 1) {
+            cpus.push_back(first);
+        }
+
+        pos = end + 1;
+    }
+
+    return cpus;
+}
+
+const cpu_topology & cpu_topology::system() {
+    static const cpu_topology topology = [] {
+        cpu_topology topology;
+        topology.load();
+        return topology;
+    }();
+
+    return topology;
+}
+
+bool cpu_topology::load(const std::string & sysfs) {
+    m_cores.clear();
+
+#ifdef __linux__
+    const std::vector<int> online = cpu_parse_list(cpu_read(sysfs + "/online"));
+    if (online.empty()) {
+        fprintf(stderr, "%s: failed to read the online CPUs from '%s'\n", __func__, sysfs.c_str());
+        return false;
+    }
+
+    // a cpuset (a container, taskset) may leave the process only some of them,
+    // another sysfs tree describes some other machine's CPUs
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const bool masked = sysfs == CPU_TOPOLOGY_SYSFS && sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    // the E cores of an Intel hybrid CPU are listed by their own PMU
+    std::vector<int> atom = cpu_parse_list(cpu_read(sysfs + "/../../cpu_atom/cpus"));
+    std::sort(atom.begin(), atom.end());
+
+    // cores by their first sibling
+    std::map<int, cpu_core> cores;
+
+    for (int cpu : online) {
+        if (masked && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))) {
+            continue;
+        }
+
+        const std::string dir = sysfs + "/cpu" + std::to_string(cpu);
+
+        std::vector<int> siblings = cpu_parse_list(cpu_read(dir + "/topology/thread_siblings_list"));
+        if (siblings.empty()) {
+            siblings.push_back(cpu);
+        }
+
+        cpu_core & core = cores[*std::min_element(siblings.begin(), siblings.end())];
+
+        if (core.cpus.empty()) {
+            core.package  = cpu_read_int(dir + "/topology/physical_package_id", 0);
+            core.capacity = cpu_read_int(dir + "/cpu_capacity", cpu_read_int(dir + "/cpufreq/cpuinfo_max_freq", 0));
+        }
+
+        core.cpus.push_back(cpu);
+        core.efficient |= std::binary_search(atom.begin(), atom.end(), cpu);
+    }
+
+    int capacity_max = 0;
+    for (const auto & [first, core] : cores) {
+        capacity_max = std::max(capacity_max, core.capacity);
+    }
+
+    for (auto & [first, core] : cores) {
+        core.efficient |= core.capacity < CPU_TOPOLOGY_EFFICIENT_RATIO*capacity_max;
+        m_cores.push_back(std::move(core));
+    }
+
+    // the map already has them in CPU order
+    std::stable_sort(m_cores.begin(), m_cores.end(), [](const cpu_core & a, const cpu_core & b) {
+        if (a.efficient != b.efficient) {
+            return !a.efficient;
+        }
+        if (a.capacity != b.capacity) {
+            return a.capacity > b.capacity;
+        }
+        return a.package < b.package;
+    });
+
+    return !m_cores.empty();
+#else
+    (void) sysfs;
+    return false;
+#endif
+}
+
+cpu_placement cpu_place(const cpu_topology & topology, int n_threads, int slot) {
+    cpu_placement placement;
+
+    const auto & cores = topology.cores();
+    const int n_cores = cores.size();
+
+    // with a single core there is nothing to keep apart
+    if (n_cores < 2) {
+        return placement;
+    }
+
+    // the slowest core for capture, unless the decoder needs every core
+    const int n_reserved = n_threads < n_cores ? 1 : 0;
+
+    if (n_reserved > 0) {
+        placement.capture = cores[n_cores - 1].cpus;
+    }
+
+    const int n_pool = n_cores - n_reserved;
+
+    if (n_threads > n_pool) {
+        // more threads than cores: all of the pool, the siblings too
+        for (int i = 0; i < n_pool; i++) {
+            placement.decode.insert(placement.decode.end(), cores[i].cpus.begin(), cores[i].cpus.end());
+        }
+    } else {
+        for (int i = 0; i < n_threads; i++) {
+            placement.decode.push_back(cores[(std::max(slot, 0)*n_threads + i) % n_pool].cpus[0]);
+        }
+    }
+
+    std::sort(placement.decode.begin(), placement.decode.end());
+
+    return placement;
+}
+
+bool cpu_pin_thread(const std::vector<int> & cpus) {
+    if (cpus.empty()) {
+        return true;
+    }
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    // 0 is the calling thread, not the whole process
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "%s: failed to set the thread affinity\n", __func__);
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,477 @@
+#include "dsp.h"
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DSP_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+//
+// Scalar reference
+//
+
+static float sum_abs_scalar(const float * x, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        sum += fabsf(x[i]);
+    }
+    return sum;
+}
+
+static float high_pass_scalar(float * x, size_t n, float alpha, float y) {
+    for (size_t i = 0; i < n; i++) {
+        y = alpha * (y + x[i] - y);
+        x[i] = y;
+    }
+    return y;
+}
+
+static void s16_to_f32_scalar(const int16_t * src, float * dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = float(src[i])/32768.0f;
+    }
+}
+
+static void s16_stereo_to_mono_f32_scalar(const int16_t * src, float * dst, size_t n_frames) {
+    for (size_t i = 0; i < n_frames; i++) {
+        dst[i] = float(src[2*i] + src[2*i + 1])/65536.0f;
+    }
+}
+
+static void s16_stereo_to_f32_scalar(const int16_t * src, float * dst_l, float * dst_r, size_t n_frames) {
+    for (size_t i = 0; i < n_frames; i++) {
+        dst_l[i] = float(src[2*i])/32768.0f;
+        dst_r[i] = float(src[2*i + 1])/32768.0f;
+    }
+}
+
+static void f32_to_s16_scalar(const float * src, int16_t * dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = int16_t(fminf(fmaxf(src[i], -1.0f), 1.0f)*32767.0f);
+    }
+}
+
+static float dot_scalar(const float * a, const float * b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i]*b[i];
+    }
+    return sum;
+}
+
+static const dsp_kernels k_scalar = {
+    "scalar",
+    sum_abs_scalar,
+    high_pass_scalar,
+    s16_to_f32_scalar,
+    s16_stereo_to_mono_f32_scalar,
+    s16_stereo_to_f32_scalar,
+    f32_to_s16_scalar,
+    dot_scalar,
+};
+
+//
+// AVX2
+//
+// y + x - y only differs from x by rounding, which is what makes the
+// high-pass loop vectorizable: the body scales by alpha, the tail runs
+// the reference loop so the returned state matches it exactly.
+//
+
+#if defined(DSP_X86)
+
+__attribute__((target("avx2")))
+static float hsum_avx2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2")))
+static float sum_abs_avx2(const float * x, size_t n) {
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_and_ps(_mm256_loadu_ps(x + i), mask));
+        acc1 = _mm256_add_ps(acc1, _mm256_and_ps(_mm256_loadu_ps(x + i + 8), mask));
+    }
+
+    return hsum_avx2(_mm256_add_ps(acc0, acc1)) + sum_abs_scalar(x + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static float high_pass_avx2(float * x, size_t n, float alpha, float y) {
+    const __m256 a = _mm256_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, _mm256_mul_ps(a, _mm256_loadu_ps(x + i)));
+    }
+
+    if (i > 0) {
+        y = x[i - 1];
+    }
+
+    return high_pass_scalar(x + i, n - i, alpha, y);
+}
+
+__attribute__((target("avx2")))
+static void s16_to_f32_avx2(const int16_t * src, float * dst, size_t n) {
+    const __m256 scale = _mm256_set1_ps(1.0f/32768.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    s16_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void s16_stereo_to_mono_f32_avx2(const int16_t * src, float * dst, size_t n_frames) {
+    const __m256  scale = _mm256_set1_ps(1.0f/65536.0f);
+    const __m256i ones  = _mm256_set1_epi16(1);
+
+    size_t i = 0;
+    for (; i + 8 <= n_frames; i += 8) {
+        // madd adds each l/r pair into one int32, exactly like the reference
+        const __m256i lr = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) (src + 2*i)), ones);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lr), scale));
+    }
+
+    s16_stereo_to_mono_f32_scalar(src + 2*i, dst + i, n_frames - i);
+}
+
+__attribute__((target("avx2")))
+static void s16_stereo_to_f32_avx2(const int16_t * src, float * dst_l, float * dst_r, size_t n_frames) {
+    const __m256  scale  = _mm256_set1_ps(1.0f/32768.0f);
+    const __m256i sel_l  = _mm256_set1_epi32(0x00000001);
+    const __m256i sel_r  = _mm256_set1_epi32(0x00010000);
+
+    size_t i = 0;
+    for (; i + 8 <= n_frames; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + 2*i));
+        _mm256_storeu_ps(dst_l + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(v, sel_l)), scale));
+        _mm256_storeu_ps(dst_r + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(v, sel_r)), scale));
+    }
+
+    s16_stereo_to_f32_scalar(src + 2*i, dst_l + i, dst_r + i, n_frames - i);
+}
+
+__attribute__((target("avx2")))
+static void f32_to_s16_avx2(const float * src, int16_t * dst, size_t n) {
+    const __m256 lo    = _mm256_set1_ps(-1.0f);
+    const __m256 hi    = _mm256_set1_ps( 1.0f);
+    const __m256 scale = _mm256_set1_ps(32767.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256  x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+        const __m256i v = _mm256_cvttps_epi32(_mm256_mul_ps(x, scale));
+        // packs works per 128-bit lane, gather both halves into the low lane
+        const __m256i p = _mm256_permute4x64_epi64(_mm256_packs_epi32(v, v), 0x08);
+        _mm_storeu_si128((__m128i *) (dst + i), _mm256_castsi256_si128(p));
+    }
+
+    f32_to_s16_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static float dot_avx2(const float * a, const float * b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+
+    return hsum_avx2(_mm256_add_ps(acc0, acc1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+static const dsp_kernels k_avx2 = {
+    "avx2",
+    sum_abs_avx2,
+    high_pass_avx2,
+    s16_to_f32_avx2,
+    s16_stereo_to_mono_f32_avx2,
+    s16_stereo_to_f32_avx2,
+    f32_to_s16_avx2,
+    dot_avx2,
+};
+
+//
+// AVX-512
+//
+
+__attribute__((target("avx512f")))
+static float sum_abs_avx512(const float * x, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_loadu_ps(x + i)));
+        acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(_mm512_loadu_ps(x + i + 16)));
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1)) + sum_abs_scalar(x + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static float high_pass_avx512(float * x, size_t n, float alpha, float y) {
+    const __m512 a = _mm512_set1_ps(alpha);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(x + i, _mm512_mul_ps(a, _mm512_loadu_ps(x + i)));
+    }
+
+    if (i > 0) {
+        y = x[i - 1];
+    }
+
+    return high_pass_scalar(x + i, n - i, alpha, y);
+}
+
+__attribute__((target("avx512f")))
+static void s16_to_f32_avx512(const int16_t * src, float * dst, size_t n) {
+    const __m512 scale = _mm512_set1_ps(1.0f/32768.0f);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) (src + i)));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(v), scale));
+    }
+
+    s16_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void s16_stereo_to_mono_f32_avx512(const int16_t * src, float * dst, size_t n_frames) {
+    const __m512  scale = _mm512_set1_ps(1.0f/65536.0f);
+    const __m512i ones  = _mm512_set1_epi16(1);
+
+    size_t i = 0;
+    for (; i + 16 <= n_frames; i += 16) {
+        const __m512i lr = _mm512_madd_epi16(_mm512_loadu_si512(src + 2*i), ones);
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(lr), scale));
+    }
+
+    s16_stereo_to_mono_f32_scalar(src + 2*i, dst + i, n_frames - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void s16_stereo_to_f32_avx512(const int16_t * src, float * dst_l, float * dst_r, size_t n_frames) {
+    const __m512  scale = _mm512_set1_ps(1.0f/32768.0f);
+    const __m512i sel_l = _mm512_set1_epi32(0x00000001);
+    const __m512i sel_r = _mm512_set1_epi32(0x00010000);
+
+    size_t i = 0;
+    for (; i + 16 <= n_frames; i += 16) {
+        const __m512i v = _mm512_loadu_si512(src + 2*i);
+        _mm512_storeu_ps(dst_l + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_madd_epi16(v, sel_l)), scale));
+        _mm512_storeu_ps(dst_r + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_madd_epi16(v, sel_r)), scale));
+    }
+
+    s16_stereo_to_f32_scalar(src + 2*i, dst_l + i, dst_r + i, n_frames - i);
+}
+
+__attribute__((target("avx512f")))
+static void f32_to_s16_avx512(const float * src, int16_t * dst, size_t n) {
+    const __m512 lo    = _mm512_set1_ps(-1.0f);
+    const __m512 hi    = _mm512_set1_ps( 1.0f);
+    const __m512 scale = _mm512_set1_ps(32767.0f);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512 x = _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(src + i), lo), hi);
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(_mm512_mul_ps(x, scale))));
+    }
+
+    f32_to_s16_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static float dot_avx512(const float * a, const float * b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i),      _mm512_loadu_ps(b + i),      acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+static const dsp_kernels k_avx512 = {
+    "avx512",
+    sum_abs_avx512,
+    high_pass_avx512,
+    s16_to_f32_avx512,
+    s16_stereo_to_mono_f32_avx512,
+    s16_stereo_to_f32_avx512,
+    f32_to_s16_avx512,
+    dot_avx512,
+};
+
+#endif // DSP_X86
+
+//
+// NEON
+//
+
+#if defined(DSP_NEON)
+
+static float sum_abs_neon(const float * x, size_t n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vaddq_f32(acc0, vabsq_f32(vld1q_f32(x + i)));
+        acc1 = vaddq_f32(acc1, vabsq_f32(vld1q_f32(x + i + 4)));
+    }
+
+    return vaddvq_f32(vaddq_f32(acc0, acc1)) + sum_abs_scalar(x + i, n - i);
+}
+
+static float high_pass_neon(float * x, size_t n, float alpha, float y) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(x + i, vmulq_n_f32(vld1q_f32(x + i), alpha));
+    }
+
+    if (i > 0) {
+        y = x[i - 1];
+    }
+
+    return high_pass_scalar(x + i, n - i, alpha, y);
+}
+
+static void s16_to_f32_neon(const int16_t * src, float * dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),  1.0f/32768.0f));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f/32768.0f));
+    }
+
+    s16_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void s16_stereo_to_mono_f32_neon(const int16_t * src, float * dst, size_t n_frames) {
+    size_t i = 0;
+    for (; i + 8 <= n_frames; i += 8) {
+        const int16x8x2_t lr = vld2q_s16(src + 2*i);
+        const int32x4_t lo = vaddl_s16(vget_low_s16(lr.val[0]),  vget_low_s16(lr.val[1]));
+        const int32x4_t hi = vaddl_s16(vget_high_s16(lr.val[0]), vget_high_s16(lr.val[1]));
+        vst1q_f32(dst + i,     vmulq_n_f32(vcvtq_f32_s32(lo), 1.0f/65536.0f));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(hi), 1.0f/65536.0f));
+    }
+
+    s16_stereo_to_mono_f32_scalar(src + 2*i, dst + i, n_frames - i);
+}
+
+static void s16_stereo_to_f32_neon(const int16_t * src, float * dst_l, float * dst_r, size_t n_frames) {
+    size_t i = 0;
+    for (; i + 8 <= n_frames; i += 8) {
+        const int16x8x2_t lr = vld2q_s16(src + 2*i);
+        vst1q_f32(dst_l + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lr.val[0]))),  1.0f/32768.0f));
+        vst1q_f32(dst_l + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lr.val[0]))), 1.0f/32768.0f));
+        vst1q_f32(dst_r + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lr.val[1]))),  1.0f/32768.0f));
+        vst1q_f32(dst_r + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lr.val[1]))), 1.0f/32768.0f));
+    }
+
+    s16_stereo_to_f32_scalar(src + 2*i, dst_l + i, dst_r + i, n_frames - i);
+}
+
+static void f32_to_s16_neon(const float * src, int16_t * dst, size_t n) {
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32( 1.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const float32x4_t x0 = vminq_f32(vmaxq_f32(vld1q_f32(src + i),     lo), hi);
+        const float32x4_t x1 = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), lo), hi);
+        const int32x4_t   v0 = vcvtq_s32_f32(vmulq_n_f32(x0, 32767.0f));
+        const int32x4_t   v1 = vcvtq_s32_f32(vmulq_n_f32(x1, 32767.0f));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(v0), vqmovn_s32(v1)));
+    }
+
+    f32_to_s16_scalar(src + i, dst + i, n - i);
+}
+
+static float dot_neon(const float * a, const float * b, size_t n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i),     vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+
+    return vaddvq_f32(vaddq_f32(acc0, acc1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+static const dsp_kernels k_neon = {
+    "neon",
+    sum_abs_neon,
+    high_pass_neon,
+    s16_to_f32_neon,
+    s16_stereo_to_mono_f32_neon,
+    s16_stereo_to_f32_neon,
+    f32_to_s16_neon,
+    dot_neon,
+};
+
+#endif // DSP_NEON
+
+std::vector<const dsp_kernels *> dsp_kernels_supported() {
+    std::vector<const dsp_kernels *> kernels;
+
+#if defined(DSP_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        kernels.push_back(&k_avx512);
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(&k_avx2);
+    }
+#endif
+
+#if defined(DSP_NEON)
+    kernels.push_back(&k_neon);
+#endif
+
+    kernels.push_back(&k_scalar);
+
+    return kernels;
+}
+
+const dsp_kernels & dsp_get_kernels() {
+    static const dsp_kernels & kernels = *dsp_kernels_supported().front();
+    return kernels;
+}
+
+const dsp_kernels & dsp_kernels_scalar() {
+    return k_scalar;
+}
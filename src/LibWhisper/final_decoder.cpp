@@ -0,0 +1,155 @@
+#include "final_decoder.h"
+
+#include "cpu_topology.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <cstdio>
+
+bool final_decoder::init(const std::string & model, const final_decoder_params & params, const audio_ring & ring) {
+    if ((m_whisper = whisper_model_acquire(model)) == nullptr) {
+        return false;
+    }
+
+    if ((m_state = whisper_model_new_state(m_whisper)) == nullptr) {
+        fprintf(stderr, "%s: failed to allocate whisper state\n", __func__);
+        return false;
+    }
+
+    m_params = params;
+    m_ring = &ring;
+
+    m_thread = std::jthread([this](std::stop_token stoken) { run(stoken); });
+
+    return true;
+}
+
+void final_decoder::push(final_job job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+
+    m_cv.notify_all();
+}
+
+bool final_decoder::pop(final_result & result, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !m_results.empty(); })) {
+        return false;
+    }
+
+    result = std::move(m_results.front());
+    m_results.pop_front();
+
+    return true;
+}
+
+size_t final_decoder::n_pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_jobs.size() + m_results.size();
+}
+
+uint64_t final_decoder::pos_oldest() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_results.empty()) {
+        return m_results.front().begin;
+    }
+
+    return m_jobs.empty() ? UINT64_MAX : m_jobs.front().begin;
+}
+
+void final_decoder::run(std::stop_token stoken) {
+    cpu_pin_thread(m_params.cpus);
+
+    while (true) {
+        final_job job;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_cv.wait(lock, stoken, [this] { return !m_jobs.empty(); })) {
+                return;
+            }
+
+            // left in m_jobs while it is decoded, for pos_oldest()
+            job = m_jobs.front();
+        }
+
+        final_result result = decode(job);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_jobs.pop_front();
+            m_results.push_back(std::move(result));
+        }
+
+        m_cv.notify_all();
+    }
+}
+
+final_result final_decoder::decode(const final_job & job) {
+    final_result result = { job.begin, job.end, {}, false };
+
+    // the draft, unless the audio is all there and decodes
+    auto draft = [&]() {
+        result.segments.clear();
+        if (!job.draft.empty()) {
+            result.segments.push_back(final_segment { job.draft, job.begin, job.end });
+        }
+        result.refined = false;
+
+        return result;
+    };
+
+    const auto audio = m_ring->range(job.begin, job.end);
+    if (audio.begin != job.begin || audio.end() != job.end) {
+        return draft();
+    }
+
+    const size_t n_samples_min = (FINAL_DECODER_MIN_MS * WHISPER_SAMPLE_RATE) / 1000;
+
+    m_pcm.assign(std::max(audio.size(), n_samples_min), 0.0f);
+    audio.copy(m_pcm.data());
+
+    // the capture may have lapped the utterance while it was copied
+    if (!m_ring->intact(audio)) {
+        return draft();
+    }
+
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+
+    wparams.print_progress   = false;
+    wparams.print_special    = false;
+    wparams.print_realtime   = false;
+    wparams.print_timestamps = false;
+    wparams.translate        = m_params.translate;
+    wparams.language         = m_params.language;
+    wparams.n_threads        = m_params.n_threads;
+
+    // each utterance on its own, the fast model's text is not good enough to prompt with
+    wparams.no_context = true;
+
+    if (whisper_full_with_state(m_whisper.get(), m_state.get(), wparams, m_pcm.data(), m_pcm.size()) != 0) {
+        fprintf(stderr, "%s: failed to process audio\n", __func__);
+        return draft();
+    }
+
+    const int n_segments = whisper_full_n_segments_from_state(m_state.get());
+    for (int i = 0; i < n_segments; ++i) {
+        // segment timestamps are in units of 10 ms relative to the utterance
+        const uint64_t t0 = job.begin + std::max<int64_t>(0, whisper_full_get_segment_t0_from_state(m_state.get(), i)) * (WHISPER_SAMPLE_RATE / 100);
+        const uint64_t t1 = job.begin + std::max<int64_t>(0, whisper_full_get_segment_t1_from_state(m_state.get(), i)) * (WHISPER_SAMPLE_RATE / 100);
+
+        result.segments.push_back(final_segment {
+            whisper_full_get_segment_text_from_state(m_state.get(), i), std::min(t0, job.end), std::clamp(t1, std::min(t0, job.end), job.end),
+        });
+    }
+
+    result.refined = true;
+
+    return result;
+}
@@ -27,8 +27,29 @@ struct CaptureDevice {
     int32_t id;
     std::string name;
 
+    std::string path;   // recording replayed instead of capturing from a device, see from_file()
+    float speed = 1.0f; // replay pacing, see stream_params::source_speed
+    int32_t channel = -1; // side of a stereo device or recording to capture, -1 for both mixed down
+
     CaptureDevice (int32_t id, std::string name) : id(id), name(name) {}
 
+    // a WAV file, or "-" for stdin, played back as if it were captured live
+    static CaptureDevice from_file(std::string path, float speed = 1.0f)
+    {
+        CaptureDevice device(-1, path);
+        device.path = path;
+        device.speed = speed;
+        return device;
+    }
+
+    // one side of the device, for transcribing each speaker of a two-channel setup on its own
+    CaptureDevice with_channel(int32_t channel) const
+    {
+        CaptureDevice device = *this;
+        device.channel = channel;
+        return device;
+    }
+
     static std::vector<CaptureDevice> devices;
 
     static std::vector<CaptureDevice>& get_devices()
@@ -54,7 +75,7 @@ struct CaptureDevice {
 };
 
 inline bool operator==(const CaptureDevice& lhs, const CaptureDevice& rhs){
-    return lhs.id == rhs.id;
+    return lhs.id == rhs.id && lhs.path == rhs.path && lhs.channel == rhs.channel;
 }
 
 namespace std
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <Transcript.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// a piece of transcribed text, timestamps in ms since the start of the audio
+struct Segment {
+    std::string text;
+    uint64_t t0;
+    uint64_t t1;
+    int speaker = 0; // index of the device it was captured from, see WhisperStream
+    std::string model = ""; // path of the model that produced the text, empty if unknown
+};
+
+typedef std::vector<Segment> OrderedSegments;
+
+// the text of the segments, in order
+std::string to_string(const OrderedSegments & segments);
+
+// a segment held by a SegmentStore, the text points into the store's arena
+// and stays valid until the store is modified
+struct SegmentRef {
+    std::string_view text;
+    uint64_t t0;
+    uint64_t t1;
+    int speaker;
+    std::string_view model;
+
+    operator Segment() const { return Segment { std::string(text), t0, t1, speaker, std::string(model) }; }
+};
+
+// Segments of a live transcript in t0 order, for a window that keeps sliding
+// forward: the texts share one arena per chunk of about SEGMENT_STORE_CHUNK_SIZE
+// segments instead of a string each, new segments go in at the end (or close
+// to it, for several speakers) and old ones are trimmed from the front a chunk
+// at a time after a binary search on t0, so every operation near the ends is
+// O(1) amortized however long the session runs.
+//
+// Copies share the chunks, so taking one copies a handful of pointers, like a
+// TranscriptView. A chunk that is shared is copied before it is changed, and
+// only that one, so a copy never sees the changes made after it was taken.
+
+// segments per chunk before a new one is started
+#define SEGMENT_STORE_CHUNK_SIZE 64
+
+class SegmentStore {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    class const_iterator {
+    public:
+        const_iterator(const SegmentStore *store, size_t chunk, size_t i) : store(store), chunk(chunk), i(i) {}
+
+        SegmentRef operator*() const { return store->ref(*store->chunks[chunk], i); }
+        const_iterator & operator++();
+
+        bool operator==(const const_iterator &other) const { return chunk == other.chunk && i == other.i; }
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+    private:
+        const SegmentStore *store;
+        size_t chunk;
+        size_t i;
+    };
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    SegmentRef operator[](size_t i) const;
+    SegmentRef front() const { return (*this)[0]; }
+    SegmentRef back() const { return (*this)[count - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0, 0); }
+    const_iterator end() const { return const_iterator(this, chunks.size(), 0); }
+
+    // add a segment after every segment that does not start later, returns its index
+    size_t insert(std::string_view text, uint64_t t0, uint64_t t1, int speaker = 0, std::string_view model = {});
+
+    void erase(size_t i);
+
+    // drop the segments that start before t0
+    void trim_before(uint64_t t0);
+
+    // index of the last segment of speaker, npos if there is none
+    size_t find_last(int speaker) const;
+
+    void clear();
+
+    // all of the text, in order
+    std::string text() const;
+
+private:
+    struct Entry {
+        size_t offset; // into the chunk's text
+        size_t length;
+        uint64_t t0;
+        uint64_t t1;
+        int speaker;
+        uint32_t model; // index into models
+    };
+
+    struct Chunk {
+        std::vector<Entry> entries;
+        std::string text;
+        size_t garbage = 0; // bytes of text no entry refers to
+    };
+
+    SegmentRef ref(const Chunk &chunk, size_t i) const;
+
+    // the chunk and the position in it of segment i, or of the end for i == size()
+    std::pair<size_t, size_t> locate(size_t i) const;
+
+    // chunk c, copied first if a copy of the store shares it
+    Chunk & modify(size_t c);
+
+    // a chunk with entries [first, last) of chunk and only their text
+    static std::shared_ptr<Chunk> rebuild(const Chunk &chunk, size_t first, size_t last);
+
+    // the index of model in models, added if it is new
+    uint32_t intern(std::string_view model);
+
+    std::deque<std::shared_ptr<Chunk>> chunks; // never empty ones
+    std::shared_ptr<const std::vector<std::string>> models; // a session only ever uses one or two
+    size_t count = 0;
+};
+
+// the segments as of one change, immutable and shared by every reader of that version
+struct SegmentSnapshot {
+    uint64_t version = 0; // increases with every change
+    SegmentStore segments;
+    TranscriptView transcript; // text of the final segments
+};
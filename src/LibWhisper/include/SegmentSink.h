@@ -0,0 +1,81 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <Segment.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Push-based delivery of the changes to a WhisperStream's segments, for
+// consumers that would rather react to each change than poll the snapshot.
+// Each sink is fed by a subscription with its own backlog and thread: the
+// streams only append to the backlog, so a slow sink delays nothing but its
+// own events.
+//
+// A full backlog first drops the events a later one supersedes (a partial
+// segment followed by another segment of its speaker, a trim followed by a
+// later trim), which loses nothing. Only when there are none is the oldest
+// event dropped; the sink is told how many before its next event and can
+// catch up from the latest snapshot.
+
+// events kept per sink before dropping any
+#define SEGMENT_SINK_BACKLOG 256
+
+struct SegmentEvent {
+    enum Kind {
+        Partial, // replaces the previous partial segment of the speaker, empty text withdraws it
+        Final,   // replaces the previous partial segment of the speaker for good
+        Trimmed, // the segments that start before segment.t0 left the window, the text is empty
+    };
+
+    Kind kind;
+    Segment segment;
+    uint64_t version = 0; // of the snapshot that includes the change, see WhisperStream::getSnapshot()
+};
+
+class SegmentSink {
+public:
+    virtual ~SegmentSink() = default;
+
+    // called from the subscription's thread, one event at a time and in order
+    virtual void onSegmentEvent(const SegmentEvent &event) = 0;
+
+    // n_dropped events were lost since the previous call of onSegmentEvent()
+    virtual void onOverflow(uint64_t /*n_dropped*/) {}
+};
+
+class SegmentSubscription {
+public:
+    SegmentSubscription(std::shared_ptr<SegmentSink> sink, size_t capacity = SEGMENT_SINK_BACKLOG);
+
+    // never waits for the sink
+    void post(SegmentEvent event);
+
+    // events lost to a full backlog, superseded ones do not count
+    uint64_t n_dropped() const { return n_dropped_total; }
+
+private:
+    void run(std::stop_token stoken);
+
+    // drop the oldest event that next makes redundant, false if there is none
+    bool drop_superseded(const SegmentEvent &next);
+
+    std::shared_ptr<SegmentSink> sink;
+    size_t capacity;
+
+    std::mutex mutex;
+    std::condition_variable_any cv;
+    std::deque<SegmentEvent> backlog;
+    uint64_t n_dropped_pending = 0; // not reported to the sink yet
+    std::atomic<uint64_t> n_dropped_total = 0;
+
+    // declared last so it is stopped before anything it uses goes away
+    std::jthread thread;
+};
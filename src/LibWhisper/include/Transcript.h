@@ -0,0 +1,105 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Transcript text kept up to date as final segments come in, for consumers
+// that need the whole text or the text of a time range over and over (the
+// prompts of the analyzer). Text is appended to blocks of about
+// TRANSCRIPT_BLOCK_SIZE bytes; full blocks are immutable and shared by every
+// view, so taking a view copies a handful of pointers, and only the last
+// block is copied when it changes after a view was taken.
+//
+// Offsets count bytes since the start of the session and never go back, so a
+// consumer that remembers end() of its last view can ask for just the text
+// added since. Segments of several speakers are kept in the order they were
+// finalized; time ranges go by the latest t0 seen so far, which is the order
+// of the text.
+
+// text per block before a new one is started
+#define TRANSCRIPT_BLOCK_SIZE 4096
+
+class TranscriptView;
+
+class Transcript {
+public:
+    Transcript();
+
+    // add the text of a final segment
+    void append(std::string_view text, uint64_t t0, uint64_t t1, int speaker = 0);
+
+    // drop the text of the segments that start before t0
+    void trim_before(uint64_t t0);
+
+    // increases with every change
+    uint64_t version() const { return m_version; }
+
+    // an immutable view of the current text
+    TranscriptView view() const;
+
+private:
+    friend class TranscriptView;
+
+    struct Entry {
+        uint64_t offset; // of the first byte of the segment's text
+        uint64_t t0;     // max of the t0s so far, so the entries stay sorted
+        uint64_t t1;
+        int speaker;
+    };
+
+    struct Block {
+        uint64_t offset = 0; // of text[0]
+        std::string text;
+        std::vector<Entry> entries;
+    };
+
+    // full blocks, then the one text is appended to
+    std::deque<std::shared_ptr<const Block>> m_full;
+    std::shared_ptr<Block> m_last;
+
+    uint64_t m_begin = 0;  // offset of the first byte not trimmed
+    uint64_t m_t0_max = 0;
+    uint64_t m_version = 0;
+};
+
+class TranscriptView {
+public:
+    TranscriptView() = default;
+
+    uint64_t version() const { return m_version; }
+
+    // offsets of the text in the view
+    uint64_t begin() const { return m_begin; }
+    uint64_t end() const { return m_end; }
+
+    bool empty() const { return m_begin == m_end; }
+
+    // all of the text
+    std::string text() const { return text(m_begin, m_end); }
+
+    // the text between two offsets, clamped to the view
+    // text(previous.end(), end()) is what was appended since an earlier view, in O(new text)
+    std::string text(uint64_t begin, uint64_t end) const;
+
+    // the text of the segments that start in [t0, t1)
+    std::string slice(uint64_t t0, uint64_t t1) const;
+
+private:
+    friend class Transcript;
+
+    // offset of the first segment with a t0 not before t0, end() if there is none
+    uint64_t find(uint64_t t0) const;
+
+    std::vector<std::shared_ptr<const Transcript::Block>> m_blocks;
+
+    uint64_t m_begin = 0;
+    uint64_t m_end = 0;
+    uint64_t m_version = 0;
+};
@@ -10,43 +10,70 @@
 #include <memory>
 #include <string>
 #include <vector>
-#include <thread>
 
 #include <CaptureDevice.h>
+#include <Segment.h>
+#include <SegmentSink.h>
 #include <stream.h>
 
+// Transcribes one or more capture devices into one list of segments. With
+// several devices, typically the local microphone and the loopback of the
+// remote party (or the two channels of one stereo device), each device gets
+// its own stream: its own capture, VAD gate and whisper state over the shared
+// model weights, decoding in parallel with the others. Segments carry the
+// index of their device as the speaker and are kept in time order.
+//
+// Every change is published as an immutable, versioned snapshot that shares
+// its chunks with the live segments and transcript, so publishing one costs a
+// few pointer copies however long the window is. Readers pick up the latest
+// one under a lock that is only ever held to copy or swap that pointer, so
+// they never wait for a decode and the streams never wait for them; a
+// snapshot stays valid for as long as a reader holds on to it.
+//
+// With a final model, the model transcribes each step for quick partial text
+// and the final model decodes every committed utterance again in the
+// background, replacing its text; each segment records which model it came
+// from. Consumers that want each change as it happens
+// subscribe a sink instead, see SegmentSink.h.
+//
+// The streams, the segments and the subscriptions live in a state of their own
+// that the threads of the streams point to, so a WhisperStream can be moved
+// while it runs; a moved-from one can only be destroyed or assigned to.
+class WhisperStream {
+public:
+    
+    WhisperStream (std::string model, std::shared_ptr<CaptureDevice> device = nullptr, std::chrono::seconds window = static_cast<std::chrono::seconds>(300), std::string finalModel = "");
 
-struct Segment {
-    std::string text;
-    uint64_t t0;
-    uint64_t t1;
-};
+    WhisperStream (std::string model, std::vector<std::shared_ptr<CaptureDevice>> devices, std::chrono::seconds window = static_cast<std::chrono::seconds>(300), std::string finalModel = "");
 
-typedef std::vector<Segment> OrderedSegments;
+    WhisperStream (WhisperStream &&other) noexcept;
+    WhisperStream& operator= (WhisperStream &&other) noexcept;
 
-namespace std{
-    std::string to_string(OrderedSegments segments);
-}
+    // stops the streams
+    ~WhisperStream ();
 
-class WhisperStream {
-public:
-    
-    WhisperStream (std::string model, std::shared_ptr<CaptureDevice> device = nullptr, std::chrono::seconds window = static_cast<std::chrono::seconds>(300));
-    
-    void task(std::stop_token stoken);
-    
-    int callback( std::string text, int64_t t0, int64_t t1, WhisperStream *ctx);
-
-    OrderedSegments& getSegments(){
-        return segments;
-    }
-protected:
-    std::jthread waiter;
-    OrderedSegments segments;
-    bool alive = true;
-    
-    //TODO: replace a string with a URI representation, ideally something accepted into or leveraging the C++ standard library
-    std::string model;
-    std::shared_ptr<CaptureDevice> device;
-    std::chrono::seconds window;
+    // the latest segments and transcript, cheap enough to poll from the UI thread
+    // a prompt only needs the text past the transcript's end() of the previous one
+    std::shared_ptr<const SegmentSnapshot> getSnapshot() const;
+
+    // deliver every change to sink from now on, from a thread of its own
+    // returns the id to unsubscribe with
+    uint64_t subscribe(std::shared_ptr<SegmentSink> sink, size_t backlog = SEGMENT_SINK_BACKLOG);
+
+    // stop delivering to a sink, waits for the event it is handling
+    void unsubscribe(uint64_t id);
+
+    // the store the streams write to, only safe to read once they have stopped
+    SegmentStore& getSegments();
+
+    // false once every stream has stopped
+    bool isAlive() const;
+
+    // pipeline counters and warmup time of the stream of a speaker, all zero when it is not running
+    stream_stats_t getStats(int speaker = 0);
+
+private:
+    struct State;
+
+    std::unique_ptr<State> state;
 };
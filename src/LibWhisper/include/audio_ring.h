@@ -0,0 +1,98 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+//
+// Lock-free audio ring buffer
+//
+// One producer (the capture callback) appends samples without ever taking a
+// lock. Consumers address samples by their absolute index since the ring was
+// created and keep their own read cursor, so several readers can follow the
+// same stream and each one only sees "samples since my last read".
+//
+// Reads hand out spans into the ring instead of copying. The producer does not
+// wait for readers: a reader that falls more than capacity() samples behind
+// loses the oldest audio (counted in cursor::n_lost), and a reader that holds
+// on to a view while the producer laps it should check intact() before
+// trusting what it copied.
+//
+// head() only moves once a block is in place, so it cannot tell a reader about
+// a write that is still in progress. The producer announces each block first
+// (a seqlock without the retry): it moves the reserved position past the block,
+// then copies the samples, then publishes head. intact() checks the copy
+// against the reserved position, which covers the samples being overwritten
+// right now as well as those already gone.
+//
+
+class audio_ring {
+public:
+    // samples between two absolute positions, split in two when they wrap around
+    struct view {
+        std::span<const float> first;
+        std::span<const float> second;
+
+        uint64_t begin = 0;
+
+        size_t   size() const { return first.size() + second.size(); }
+        uint64_t end()  const { return begin + size(); }
+        bool     empty() const { return size() == 0; }
+
+        // copy the samples into dst, which must hold size() floats
+        void copy(float * dst) const;
+    };
+
+    // per-consumer read position
+    struct cursor {
+        uint64_t pos    = 0;
+        uint64_t n_lost = 0; // samples overwritten before this consumer read them
+    };
+
+    // capacity is rounded up to a power of two
+    explicit audio_ring(size_t n_samples);
+
+    // producer only
+    void write(const float * data, size_t n_samples);
+
+    // absolute index one past the newest sample
+    uint64_t head() const { return m_head.load(std::memory_order_acquire); }
+
+    size_t capacity() const { return m_data.size(); }
+
+    // a cursor that starts reading at the current head
+    cursor make_cursor() const { return cursor { head(), 0 }; }
+
+    // samples written since the cursor position, at most max_samples
+    // a cursor that fell out of the ring is moved up to the oldest resident sample
+    view read(cursor & c, size_t max_samples = SIZE_MAX) const;
+
+    // advance the cursor past samples the consumer is done with
+    void consume(cursor & c, size_t n_samples) const { c.pos += n_samples; }
+
+    // samples in [begin, end), clamped to what is still resident
+    view range(uint64_t begin, uint64_t end) const;
+
+    // the newest n_samples samples
+    view latest(size_t n_samples) const;
+
+    // samples at the start of v the producer has overwritten or is overwriting
+    // call after copying out of v, whatever was copied past them is sound
+    size_t n_overwritten(const view & v) const;
+
+    // true if the producer has not touched any sample of v yet
+    bool intact(const view & v) const { return n_overwritten(v) == 0; }
+
+private:
+    view make_view(uint64_t begin, uint64_t end) const;
+
+    std::vector<float> m_data;
+    size_t             m_mask = 0;
+
+    std::atomic<uint64_t> m_head     = 0;
+    std::atomic<uint64_t> m_reserved = 0; // one past the newest sample being written, ahead of m_head during a write
+};
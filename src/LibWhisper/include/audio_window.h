@@ -0,0 +1,62 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <audio_ring.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Sliding analysis window
+//
+// Keeps the most recent samples contiguous in a fixed arena so whisper_full
+// can be handed a pointer into it. Sliding the window only moves the head
+// offset; the samples are moved back to the start of the arena only when
+// the tail runs into its end, which happens once every few steps when the
+// arena is a few windows long.
+//
+// The window knows the capture ring positions of its samples, so a consumer
+// that is handed successive ranges of the ring, like the decoder popping
+// queued windows, can slide() it from one range to the next and only copy
+// the samples it has not seen yet.
+//
+
+class audio_window {
+public:
+    // n_capacity is a hint, the arena grows if a single push does not fit
+    explicit audio_window(size_t n_capacity = 0);
+
+    // append new samples, then drop the oldest ones so that at most n_max remain
+    // the samples being pushed are always kept, even if there are more than n_max
+    void push(const audio_ring::view & audio, size_t n_max);
+
+    // drop all but the newest n samples
+    void keep(size_t n);
+
+    // make the window hold the samples in [begin, end) of ring, copying only those it does not have yet
+    // the window starts after begin if the ring lost part of that audio, returns where it starts
+    uint64_t slide(const audio_ring & ring, uint64_t begin, uint64_t end);
+
+    void clear() { m_head = m_tail = 0; }
+
+    const float * data() const { return m_data.data() + m_head; }
+    size_t        size() const { return m_tail - m_head; }
+    bool          empty() const { return m_head == m_tail; }
+
+    // capture ring positions of the samples
+    uint64_t begin() const { return m_end - size(); }
+    uint64_t end()   const { return m_end; }
+
+private:
+    // make room for n more samples at the tail
+    void reserve_tail(size_t n);
+
+    std::vector<float> m_data;
+
+    size_t m_head = 0;
+    size_t m_tail = 0;
+
+    uint64_t m_end = 0; // capture ring index one past the newest sample
+};
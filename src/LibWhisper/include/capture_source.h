@@ -0,0 +1,98 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <wav_reader.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// Capture sources
+//
+// Where audio_async gets its audio from. A source delivers mono float samples
+// at the sample rate it was opened with to a sink, from its own thread, for as
+// long as it is resumed.
+//
+
+class capture_sink {
+public:
+    virtual ~capture_sink() = default;
+
+    // never blocks
+    virtual void write(const float * data, size_t n_samples) = 0;
+
+    // samples that can be written before audio the reader still needs is overwritten
+    virtual size_t space() const = 0;
+};
+
+class capture_source {
+public:
+    virtual ~capture_source() = default;
+
+    // prepare to deliver audio at sample_rate to sink, paused
+    virtual bool open(int sample_rate, capture_sink * sink) = 0;
+
+    virtual bool resume() = 0;
+    virtual bool pause() = 0;
+
+    // the sample rate the audio is delivered at
+    virtual int sample_rate() const = 0;
+
+    // true once the source has delivered all of its audio, never for live devices
+    virtual bool finished() const { return false; }
+};
+
+//
+// Replay of a WAV file or pipe
+//
+// Plays a recording into the sink as if it were captured live, for
+// reproducing a session or running the streaming path without a microphone.
+// The speed sets the pacing: 1 is real time, 2 twice as fast and so on, and 0
+// delivers the audio as fast as the reader consumes it, waiting whenever the
+// sink has no space left so no audio is lost.
+//
+// Stereo recordings are mixed down, unless a channel is picked: a call
+// recorded with the local microphone on one side and the remote party on the
+// other can be transcribed one speaker at a time.
+//
+
+class file_capture_source : public capture_source {
+public:
+    // path of a WAV file, or "-" for stdin
+    // channel 0 or 1 replays one side of a stereo recording, -1 mixes them
+    file_capture_source(std::string path, float speed = 1.0f, int channel = -1);
+
+    bool open(int sample_rate, capture_sink * sink) override;
+
+    bool resume() override;
+    bool pause() override;
+
+    int sample_rate() const override { return m_sample_rate; }
+
+    bool finished() const override { return m_finished; }
+
+private:
+    void run(std::stop_token stoken);
+
+    std::string m_path;
+    float       m_speed;
+    int         m_channel;
+    int         m_sample_rate = 0;
+
+    wav_reader     m_reader;
+    capture_sink * m_sink = nullptr;
+
+    std::mutex                  m_mutex;
+    std::condition_variable_any m_cv;
+    bool                        m_running = false;
+    std::atomic_bool            m_finished = false;
+
+    // declared last so it is stopped before anything it uses goes away
+    std::jthread m_thread;
+};
@@ -2,24 +2,75 @@
 
 #include <LibWhisper.h>
 
+#include <audio_ring.h>
+#include <capture_source.h>
+#include <resampler.h>
+
 #include <SDL3/SDL.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <mutex>
 
 //
-// SDL Audio capture
+// SDL capture device
+//
+// The device is opened at its own rate and the audio resampled in-tree to the
+// rate that was asked for, instead of relying on SDL's conversion. A stereo
+// device is mixed down by SDL, unless one of its channels is picked.
 //
 
-class audio_async {
+class sdl_capture_source : public capture_source {
+public:
+    // capture_id is an index into SDL_GetAudioRecordingDevices(), -1 for the default device
+    // channel 0 or 1 captures one side of a stereo device, -1 all of it mixed down
+    explicit sdl_capture_source(int capture_id, int channel = -1);
+    ~sdl_capture_source();
+
+    bool open(int sample_rate, capture_sink * sink) override;
+
+    bool resume() override;
+    bool pause() override;
+
+    int sample_rate() const override { return m_sample_rate; }
+
+private:
+    // called by SDL with audio at the device rate
+    void deliver(const float * data, size_t n_samples);
+
+    int m_capture_id;
+    int m_channel;
+    int m_sample_rate = 0;
+
+    SDL_AudioDeviceID m_dev_id_in = 0;
+    SDL_AudioStream * m_stream = nullptr;
+
+    capture_sink *     m_sink = nullptr;
+    resampler          m_resampler;
+    std::vector<float> m_picked; // the channel taken out of stereo frames
+    std::vector<float> m_resampled;
+};
+
+//
+// Audio capture
+//
+// Keeps the last len_ms of the audio of a capture source, by default the SDL
+// device, for the consumers to read.
+//
+
+class audio_async : public capture_sink {
 public:
     audio_async(int len_ms);
     ~audio_async();
 
     bool init(int capture_id, int sample_rate);
 
+    // capture from source instead of an SDL device
+    bool init(std::unique_ptr<capture_source> source, int sample_rate);
+
     // start capturing audio via the provided SDL callback
     // keep last len_ms seconds of audio in a circular buffer
     bool resume();
@@ -27,23 +78,74 @@ public:
     bool clear();
 
     // callback to be called by SDL
+    // samples go straight into the lock-free ring, the consumer's mutex is only
+    // passed through, for as long as the consumer checks its condition, to wake it
     void callback(uint8_t * stream, int len);
 
+    // capture_sink, what the callback does for float samples
+    void   write(const float * data, size_t n_samples) override;
+    size_t space() const override;
+
+    // true once a file source has delivered all of its audio
+    bool finished() const { return m_source && m_source->finished(); }
+
     // get audio data from the circular buffer
     void get(int ms, std::vector<float> & audio);
 
+    // block until at least n_samples have been captured since the last clear()
+    // the callback only signals once that amount is reached, so the consumer
+    // wakes up once per step instead of polling
+    // returns false if the timeout expired first
+    bool wait(size_t n_samples, int timeout_ms);
+
+    // same, for samples past a consumer's own cursor
+    bool wait(const audio_ring::cursor & cursor, size_t n_samples, int timeout_ms);
+
+    // number of samples captured since the last clear()
+    size_t available();
+
+    // audio from pos on is still needed by another consumer, space() leaves it alone as well
+    // UINT64_MAX to hold nothing
+    void hold(uint64_t pos) { m_hold_pos.store(pos, std::memory_order_relaxed); }
+
+    // cursor based access to the captured audio, see audio_ring
+    audio_ring::cursor cursor() const { return m_ring->make_cursor(); }
+    // the reader position is what space() leaves alone
+    audio_ring::view   read(audio_ring::cursor & cursor, size_t max_samples = SIZE_MAX);
+
+    const audio_ring & ring() const { return *m_ring; }
+
+    int sample_rate() const { return m_sample_rate; }
+
+    // pin the thread that delivers the audio to cpus, on its first write
+    // must be called while paused
+    void set_capture_cpus(std::vector<int> cpus);
+
 private:
-    SDL_AudioDeviceID m_dev_id_in = 0;
+    std::unique_ptr<capture_source> m_source;
+
+    std::vector<int> m_capture_cpus;
+    std::atomic_bool m_pin_pending = false;
 
     int m_len_ms = 0;
     int m_sample_rate = 0;
 
     std::atomic_bool m_running;
-    std::mutex       m_mutex;
 
-    std::vector<float> m_audio;
-    size_t             m_audio_pos = 0;
-    size_t             m_audio_len = 0;
+    std::unique_ptr<audio_ring> m_ring;
+
+    // consumer side: position of the last clear()
+    uint64_t m_clear_pos = 0;
+
+    // oldest sample the reader may still look at, see space()
+    std::atomic<uint64_t> m_read_pos = 0;
+    std::atomic<uint64_t> m_hold_pos = UINT64_MAX;
+
+    // absolute ring position a waiting consumer needs, UINT64_MAX if nobody waits
+    // only used to wake the consumer, the callback only takes m_mutex when it does
+    std::atomic<uint64_t>   m_notify_at = UINT64_MAX;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
 };
 
 // Return false if need to quit
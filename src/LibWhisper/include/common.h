@@ -4,6 +4,9 @@
 
 #include <LibWhisper.h>
 
+#include "dsp.h"
+
+#include <algorithm>
 #include <string>
 #include <map>
 #include <vector>
@@ -143,7 +146,8 @@ bool is_wav_buffer(const std::string buf);
 
 // Read WAV audio file and store the PCM data into pcmf32
 // fname can be a buffer of WAV data instead of a filename
-// The sample rate of the audio must be equal to COMMON_SAMPLE_RATE
+// Long recordings are better read block by block with wav_reader
+// Audio at other rates than COMMON_SAMPLE_RATE is resampled to it
 // If stereo flag is set and the audio has 2 channels, the pcmf32s will contain 2 channel PCM
 bool read_wav(
         const std::string & fname,
@@ -186,11 +190,17 @@ private:
     }
 
     // It is assumed that PCM data is normalized to a range from -1 to 1
+    // Samples are converted and written in blocks, the header is patched once per call
+    // For continuous recording see session_recorder, which also avoids the seeks
     bool write_audio(const float * data, size_t length) {
-        for (size_t i = 0; i < length; ++i) {
-            const int16_t intSample = int16_t(data[i] * 32767);
-            file.write(reinterpret_cast<const char *>(&intSample), sizeof(int16_t));
-            dataSize += sizeof(int16_t);
+        const auto & dsp = dsp_get_kernels();
+
+        int16_t block[4096];
+        for (size_t i = 0; i < length; i += 4096) {
+            const size_t n = std::min<size_t>(4096, length - i);
+            dsp.f32_to_s16(data + i, block, n);
+            file.write(reinterpret_cast<const char *>(block), n*sizeof(int16_t));
+            dataSize += n*sizeof(int16_t);
         }
         if (file.is_open()) {
             file.seekp(4, std::ios::beg);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <string>
+#include <vector>
+
+//
+// CPU topology and thread placement
+//
+// Left to the scheduler, the decoder's threads share SMT siblings with each
+// other and with the capture thread, or land on efficiency cores, and every
+// whisper_full call takes as long as its slowest thread. The topology groups
+// the logical CPUs the process may run on into physical cores, fastest first,
+// and a placement gives each kind of thread cores of its own:
+//
+//   decode  - one logical CPU on each of n_threads physical cores, starting
+//             with the fastest. ggml creates its workers from the decoding
+//             thread, so they inherit its mask and each runs on a distinct
+//             physical core.
+//   capture - the slowest core, with both of its siblings, but only if the
+//             decoder has enough cores without it: the capture callback and
+//             the window assembler need little, and taking a core the decoder
+//             needs would put two of its threads on SMT siblings.
+//
+// Nothing is placed for the GUI: pinning it to a slow core makes the UI
+// sluggish, and the decoder's pinned threads already leave it the rest.
+//
+// Several streams take consecutive slots, each its own run of cores as far
+// as the machine has them. An empty set leaves that thread unpinned, which is
+// all there is where the topology cannot be read (anything but Linux) or has
+// too few cores to keep the threads apart.
+//
+// Placement is opt-in (stream_params.placement): whether it beats the
+// scheduler depends on the machine, measure with libwhisper-bench -pl.
+//
+
+// sysfs directory with the cpuN subdirectories
+#define CPU_TOPOLOGY_SYSFS "/sys/devices/system/cpu"
+
+// below this fraction of the fastest core's capacity a core counts as an efficiency core
+#define CPU_TOPOLOGY_EFFICIENT_RATIO 0.75
+
+struct cpu_core {
+    std::vector<int> cpus; // logical CPUs, the SMT siblings of the core
+    int package  = 0;
+    int capacity = 0;      // cpu_capacity, or the maximum frequency in kHz, 0 if neither is known
+    bool efficient = false; // an E core of a hybrid CPU or a LITTLE core
+};
+
+class cpu_topology {
+public:
+    // the topology of this machine, read once
+    static const cpu_topology & system();
+
+    // read the CPUs from sysfs, only those in the affinity mask of the process
+    // unless sysfs is some other tree, a copy of another machine's say
+    bool load(const std::string & sysfs = CPU_TOPOLOGY_SYSFS);
+
+    // performance cores first, faster before slower, then in package and CPU order
+    const std::vector<cpu_core> & cores() const { return m_cores; }
+
+    bool empty() const { return m_cores.empty(); }
+
+private:
+    std::vector<cpu_core> m_cores;
+};
+
+struct cpu_placement {
+    std::vector<int> decode;
+    std::vector<int> capture;
+};
+
+// where to put the threads of the stream in slot, decoding with n_threads threads
+cpu_placement cpu_place(const cpu_topology & topology, int n_threads, int slot = 0);
+
+// restrict the calling thread to cpus, false if that is not supported or fails
+// an empty set does nothing and succeeds
+bool cpu_pin_thread(const std::vector<int> & cpus);
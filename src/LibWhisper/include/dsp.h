@@ -0,0 +1,55 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Audio DSP kernels
+//
+// Hot loops of the audio utilities, with AVX2/AVX-512 (x86, GCC/Clang) and
+// NEON (AArch64) variants. The variant is picked once at runtime from the CPU
+// features; the scalar variant is the reference implementation and is always
+// available through dsp_kernels_scalar().
+//
+// The int16 conversions are exact in every variant (for finite input). The float reductions
+// change the summation order, so their results only match the scalar ones
+// within rounding error.
+//
+
+struct dsp_kernels {
+    const char * name;
+
+    // sum of |x[i]|
+    float (*sum_abs)(const float * x, size_t n);
+
+    // the loop of high_pass_filter(): for each sample, y = alpha*((y + x[i]) - y), x[i] = y
+    // y is the previous output, the new one is returned so blocks can be chained
+    float (*high_pass)(float * x, size_t n, float alpha, float y);
+
+    // x/32768
+    void (*s16_to_f32)(const int16_t * src, float * dst, size_t n);
+
+    // interleaved stereo to mono, (l + r)/65536
+    void (*s16_stereo_to_mono_f32)(const int16_t * src, float * dst, size_t n_frames);
+
+    // interleaved stereo to two channels, x/32768
+    void (*s16_stereo_to_f32)(const int16_t * src, float * dst_l, float * dst_r, size_t n_frames);
+
+    // clamp(x, -1, 1)*32767, truncated towards zero
+    void (*f32_to_s16)(const float * src, int16_t * dst, size_t n);
+
+    // sum of a[i]*b[i], the inner loop of the resampler
+    float (*dot)(const float * a, const float * b, size_t n);
+};
+
+// the best variant supported by this CPU
+const dsp_kernels & dsp_get_kernels();
+
+// the portable reference variant
+const dsp_kernels & dsp_kernels_scalar();
+
+// every variant this CPU supports, best first, ending with the scalar one
+std::vector<const dsp_kernels *> dsp_kernels_supported();
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <audio_ring.h>
+#include <whisper_model.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// Background decoder of final text
+//
+// The second pass of a model cascade. A small, fast model transcribes every
+// step of the stream for low-latency partial text; once an utterance is
+// committed, its audio is decoded again by a larger, more accurate model on
+// this decoder's own thread and the result replaces the fast model's text.
+//
+// Utterances are addressed by their positions in the capture ring the fast
+// model's windows come from, and their audio is only copied out of it when the
+// decoder gets to them. An utterance whose audio was overwritten by then, when
+// the decoder fell more than the ring behind the capture, keeps the fast
+// model's draft.
+//
+
+// shorter utterances are padded with silence, whisper does not decode less than a second
+#define FINAL_DECODER_MIN_MS 1100
+
+struct final_decoder_params {
+    int32_t n_threads = 4;
+
+    const char * language = "en";
+    bool translate = false;
+
+    std::vector<int> cpus; // to pin the decoding thread to, empty to leave it to the scheduler
+};
+
+// an utterance committed by the fast model
+struct final_job {
+    uint64_t begin; // capture ring positions of its audio
+    uint64_t end;
+    std::string draft; // the fast model's text
+};
+
+struct final_segment {
+    std::string text;
+    uint64_t begin; // capture ring positions
+    uint64_t end;
+};
+
+struct final_result {
+    uint64_t begin;
+    uint64_t end;
+    std::vector<final_segment> segments; // empty when nothing was said
+    bool refined; // false if the audio was gone and the segment is the draft
+};
+
+class final_decoder {
+public:
+    // decode with the weights of model, shared with other streams, and a state of its own
+    bool init(const std::string & model, const final_decoder_params & params, const audio_ring & ring);
+
+    // queue an utterance, never blocks
+    void push(final_job job);
+
+    // the oldest utterance if it is decoded, waiting up to timeout_ms for it
+    // results come in the order the utterances were pushed
+    bool pop(final_result & result, int timeout_ms = 0);
+
+    // utterances pushed and not popped yet
+    size_t n_pending() const;
+
+    // ring position of the oldest audio a pending utterance needs, UINT64_MAX if there is none
+    uint64_t pos_oldest() const;
+
+private:
+    void run(std::stop_token stoken);
+
+    final_result decode(const final_job & job);
+
+    final_decoder_params m_params;
+
+    std::shared_ptr<whisper_context> m_whisper;
+    unique_whisper_state m_state;
+    const audio_ring * m_ring = nullptr;
+
+    std::vector<float> m_pcm;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable_any m_cv;
+    std::deque<final_job> m_jobs;       // not decoded yet, the front one is being decoded
+    std::deque<final_result> m_results; // decoded, not popped yet
+
+    // declared last so it is stopped before anything it uses goes away
+    std::jthread m_thread;
+};
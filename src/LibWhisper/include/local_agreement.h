@@ -0,0 +1,63 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Stable-prefix commit of streaming hypotheses (LocalAgreement-2)
+//
+// Every step decodes the audio after the commit point again. A token is only
+// committed once two consecutive decodes agree on it, so the committed text
+// never changes afterwards; the rest of the latest decode is the tentative
+// tail, which the next decode may still revise. Commits stop at word
+// boundaries, and the audio before the commit point is no longer needed by
+// the decoder.
+//
+
+struct hypothesis_token {
+    int32_t     id;
+    std::string text;
+
+    uint64_t t0; // capture ring index of the start of the token
+    uint64_t t1; // capture ring index of the end of the token
+};
+
+// a token of a decode of the window that starts at capture ring index begin; t0 and t1 are
+// whisper's timestamps, in units of 10 ms relative to the window, -1 where it has none
+hypothesis_token hypothesis_token_from_whisper(int32_t id, std::string text, uint64_t begin, int64_t t0, int64_t t1);
+
+class local_agreement {
+public:
+    // pos is the capture ring index the first decode starts at
+    explicit local_agreement(uint64_t pos = 0);
+
+    // tokens of a new decode, in order; tokens that end before the commit point
+    // or repeat the end of the committed text are ignored
+    // the tokens committed by this update are appended to committed
+    // flush commits the whole decode, for a window that cannot grow any further
+    void update(std::vector<hypothesis_token> && tokens, bool flush, std::vector<hypothesis_token> & committed);
+
+    // nothing was said up to pos, the audio before it can go
+    void advance(uint64_t pos);
+
+    // the uncommitted tail of the last decode
+    const std::vector<hypothesis_token> & tentative() const { return m_tentative; }
+
+    // capture ring index of the end of the committed audio
+    uint64_t pos_commit() const { return m_pos_commit; }
+
+    // the newest committed tokens, at most n_max, to prompt the next decode with
+    void prompt(std::vector<int32_t> & tokens, size_t n_max) const;
+
+private:
+    void commit(std::vector<hypothesis_token> & tokens, size_t n, std::vector<hypothesis_token> & committed);
+
+    uint64_t m_pos_commit;
+
+    std::vector<hypothesis_token> m_tentative;
+    std::vector<hypothesis_token> m_history; // tail of the committed tokens
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Polyphase resampler
+//
+// Converts a mono stream between two sample rates, for recordings and capture
+// devices that do not run at whisper's 16 kHz. The ratio is reduced to L/M and
+// every output sample is one dot product of the input with one of L phases of
+// a Kaiser-windowed sinc, through the dsp kernels. The cutoff sits just below
+// the lower of the two Nyquist frequencies, and the filter gets longer as the
+// ratio goes down so the transition band stays the same width at the output.
+//
+// Ratios whose L exceeds RESAMPLER_MAX_PHASES (44100 to 16001 Hz, say) use the
+// nearest of RESAMPLER_MAX_PHASES phases; the position in the input is still
+// tracked exactly, so only the fine timing of each sample is rounded.
+//
+// The resampler keeps its history between calls, so a stream can be fed in
+// blocks of any size. Each block gives out what the input so far allows, the
+// filter's look-ahead of half its length stays behind until flush().
+//
+
+// zero crossings of the sinc on each side of the center, at the output rate
+#define RESAMPLER_ZERO_CROSSINGS 16
+
+// Kaiser window shape, about 80 dB of stopband attenuation
+#define RESAMPLER_KAISER_BETA 8.0
+
+// cutoff relative to the lower Nyquist frequency
+#define RESAMPLER_ROLLOFF 0.94
+
+#define RESAMPLER_MAX_PHASES 1024
+
+class resampler {
+public:
+    resampler() = default;
+    resampler(int rate_in, int rate_out);
+
+    int rate_in()  const { return m_rate_in; }
+    int rate_out() const { return m_rate_out; }
+
+    // true when the rates are equal and process() only copies
+    bool passthrough() const { return m_up == m_down; }
+
+    // upper bound of the output process() or flush() give for n_in more input samples
+    size_t max_output(size_t n_in) const;
+
+    // resample n_in samples, returns the number of samples written to out
+    size_t process(const float * in, size_t n_in, float * out);
+
+    // resample the rest of the stream, as if it were followed by silence
+    // returns the number of samples written to out, the stream then ends
+    size_t flush(float * out);
+
+    // forget the history, for a new stream at the same rates
+    void reset();
+
+private:
+    size_t run(float * out, uint64_t n_max);
+
+    int m_rate_in  = 0;
+    int m_rate_out = 0;
+
+    // the ratio reduced to m_up/m_down
+    uint64_t m_up   = 1;
+    uint64_t m_down = 1;
+
+    int m_n_taps   = 0;
+    int m_n_phases = 0;
+
+    // m_n_phases + 1 phases of m_n_taps coefficients, the last one is the first shifted by a sample
+    std::vector<float> m_filter;
+
+    // input not consumed yet, preceded by the history the filter still needs
+    std::vector<float> m_buf;
+
+    // position of the next output: m_buf[m_pos] is its first tap, m_frac/m_up the fraction of a sample past it
+    size_t   m_pos  = 0;
+    uint64_t m_frac = 0;
+
+    uint64_t m_n_in  = 0;
+    uint64_t m_n_out = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+//
+// Adaptive step/length controller
+//
+// Tracks the real-time factor of the decoder (decode time / audio time, as an
+// exponential moving average) and picks the shortest step the decoder can keep
+// up with, so that each step leaves target_load of its duration for decoding.
+// The window keeps the configured length unless even the longest step cannot
+// absorb its decode time, in which case the window is shortened instead.
+//
+
+struct rtf_controller_params {
+    int step_ms_min   = 500;
+    int step_ms_max   = 5000;
+    int length_ms_min = 3000;
+    int length_ms_max = 15000;
+
+    float target_load = 0.7f; // fraction of a step the decoder may spend on a window
+    float smoothing   = 0.2f; // weight of the newest measurement in the average
+};
+
+// widen the bounds of params to hold the configured step_ms and length_ms, with min <= max
+// and length_ms_min >= step_ms_min; step_ms must not exceed length_ms
+// returns true if the bounds already held them
+bool rtf_controller_fit_bounds(rtf_controller_params & params, int step_ms, int length_ms);
+
+class rtf_controller {
+public:
+    rtf_controller(const rtf_controller_params & params, int step_ms, int length_ms);
+
+    // account one decode of audio_ms of audio that took decode_ms
+    void update(double decode_ms, double audio_ms);
+
+    int   step_ms()   const { return m_step_ms; }
+    int   length_ms() const { return m_length_ms; }
+    float rtf()       const { return m_rtf; }
+
+private:
+    rtf_controller_params m_params;
+
+    int   m_length_ms_pref;
+    int   m_step_ms;
+    int   m_length_ms;
+    float m_rtf = 0.0f;
+};
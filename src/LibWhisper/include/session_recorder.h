@@ -0,0 +1,105 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <audio_ring.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+//
+// Session recorder
+//
+// Archives the captured audio to a 16-bit mono WAV file. The recorder follows
+// the capture ring with its own cursor from a background thread, so the
+// capture callback never waits for the disk: it only writes to the ring as
+// before. Samples are converted into a large aligned buffer that goes to the
+// file in one unbuffered write when it fills up.
+//
+// The RIFF header is only rewritten at checkpoints, every checkpoint_ms and on
+// close(), so a crash loses at most the audio since the last checkpoint. The
+// data written after it is still in the file, past the size the header
+// declares.
+//
+// A recorder that falls more than the ring capacity behind (a stalled disk)
+// writes silence for the audio it lost, so the recording keeps its timing.
+//
+
+// how often the writer picks up new audio from the ring
+#define SESSION_RECORDER_POLL_MS 50
+
+// default interval between header updates
+#define SESSION_RECORDER_CHECKPOINT_MS 5000
+
+// size of the write buffer in samples, 4 s at 16 kHz
+#define SESSION_RECORDER_BUFFER_SAMPLES (64*1024)
+
+class session_recorder {
+public:
+    session_recorder() = default;
+    ~session_recorder();
+
+    session_recorder(const session_recorder &) = delete;
+    session_recorder & operator=(const session_recorder &) = delete;
+
+    // start recording the samples written to ring from now on
+    // ring has to outlive the recorder, or at least the call to close()
+    bool open(const std::string & path, const audio_ring & ring, int sample_rate, int checkpoint_ms = SESSION_RECORDER_CHECKPOINT_MS);
+
+    // write the audio captured so far and finalize the header
+    bool close();
+
+    // ask the writer to flush and update the header at its next wakeup
+    void checkpoint();
+
+    bool is_open() const { return m_file != nullptr; }
+
+    // samples in the file, including the silence written for lost ones
+    uint64_t n_written() const { return m_n_written; }
+
+    // samples overwritten in the ring before the recorder got to them
+    uint64_t n_lost() const { return m_n_lost; }
+
+private:
+    struct aligned_delete {
+        void operator()(int16_t * p) const { ::operator delete[](p, std::align_val_t(4096)); }
+    };
+
+    void run(std::stop_token stoken);
+
+    // move everything the ring has past the cursor into the file
+    bool drain();
+
+    // write the buffered samples, optionally followed by a header update
+    bool flush(bool update_header);
+
+    bool write_header();
+
+    std::string  m_path;
+    FILE *       m_file = nullptr;
+    int          m_sample_rate = 0;
+    int          m_checkpoint_ms = 0;
+
+    const audio_ring * m_ring = nullptr;
+    audio_ring::cursor m_cursor;
+
+    std::unique_ptr<int16_t[], aligned_delete> m_buffer;
+    size_t                                     m_n_buffered = 0;
+
+    std::atomic<uint64_t> m_n_written = 0;
+    std::atomic<uint64_t> m_n_lost    = 0;
+
+    std::mutex                  m_mutex;
+    std::condition_variable_any m_cv;
+    bool                        m_checkpoint = false;
+
+    // declared last so it is stopped before anything it uses goes away
+    std::jthread m_thread;
+};
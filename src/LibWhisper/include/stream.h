@@ -9,6 +9,22 @@
 extern "C" {
 #endif
 
+// what to do with the backlog when the decoder falls behind the capture
+typedef enum stream_overflow_policy {
+    STREAM_OVERFLOW_DROP_OLDEST = 0, // drop the oldest queued window
+    STREAM_OVERFLOW_COALESCE    = 1, // merge new audio into the newest queued window, up to 30 s
+    STREAM_OVERFLOW_DEGRADE     = 2, // decode queued windows with a reduced audio context, drop the oldest when full
+} stream_overflow_policy_t;
+
+// where the threads of a stream run, see cpu_topology.h
+typedef enum stream_placement {
+    STREAM_PLACEMENT_NONE  = 0, // leave them to the scheduler
+    STREAM_PLACEMENT_CORES = 1, // decoder on n_threads distinct physical cores, capture on a spare slow core, speaker picks the cores
+} stream_placement_t;
+
+// size the encoder context to each window instead of a fixed audio_ctx
+#define STREAM_AUDIO_CTX_AUTO (-1)
+
 typedef struct stream_params {
     int32_t n_threads;
     int32_t step_ms;
@@ -16,19 +32,41 @@ typedef struct stream_params {
     int32_t keep_ms;
     int32_t capture_id;
     int32_t max_tokens;
-    int32_t audio_ctx;
+    int32_t audio_ctx; // 0 for the full 30 s context, STREAM_AUDIO_CTX_AUTO to fit each window
+    int32_t queue_depth;
+    int32_t channel; // channel of a stereo device or source to transcribe, -1 to mix them down
+    int32_t speaker; // passed on with the segments, to tell streams of different channels apart
+    int32_t final_n_threads; // threads of final_model, 0 for n_threads
+
+    // bounds for the adaptive controller, see adaptive
+    int32_t step_ms_min;
+    int32_t step_ms_max;
+    int32_t length_ms_min;
+    int32_t length_ms_max;
+
+    stream_overflow_policy_t overflow_policy;
+    stream_placement_t placement; // the decoder is the thread that calls stream_run, ggml's workers follow it
 
     float vad_thold;
     float freq_thold;
+    float source_speed; // pacing of source: 1 for real time, 2 for twice as fast, 0 as fast as it is decoded
 
     bool speed_up;
     bool translate;
     bool print_special;
     bool no_context;
     bool no_timestamps;
+    bool warmup;      // run a silent window through the model before the first real one
+    bool lock_memory; // lock the process memory, including the model weights, into RAM
+    bool adaptive;    // retune step_ms/length_ms from the measured real-time factor (fixed step mode)
+    bool incremental; // commit the text consecutive windows agree on and drop its audio from the next window (fixed step mode)
+    bool vad_gate;    // skip the steps without speech instead of decoding them (fixed step mode)
 
     const char *language;
     const char *model;
+    const char *final_model; // larger model that decodes each committed utterance again in the background, NULL for none
+    const char *source; // WAV file or "-" for stdin to replay instead of capturing from capture_id, NULL for the device
+    const char *record; // WAV file to archive the captured audio to, NULL to not record
 } stream_params_t;
 
 stream_params_t stream_default_params();
@@ -38,9 +76,61 @@ typedef struct stream_context *stream_context_t;
 stream_context_t stream_init(stream_params_t params);
 void stream_free(stream_context_t ctx);
 
+typedef struct stream_stats {
+    int32_t  queue_depth;       // windows waiting to be decoded
+    int32_t  queue_depth_max;   // high-water mark of queue_depth
+    uint64_t n_windows;         // windows assembled from the capture
+    uint64_t n_decoded;         // windows handed to whisper
+    uint64_t n_dropped;         // windows dropped by the overflow policy
+    uint64_t n_coalesced;       // windows merged into a queued one
+    uint64_t n_degraded;        // windows decoded with reduced settings
+    uint64_t n_samples_dropped; // audio lost with dropped windows
+    uint64_t n_samples_lost;    // audio overwritten in the capture buffer before it was read
+    int32_t  warmup_ms;         // time spent warming up the model in stream_init, 0 without warmup
+    float    rtf;               // decode time / audio time, moving average
+    int32_t  step_ms;           // current step, differs from the parameters when adaptive
+    int32_t  length_ms;         // current window length, differs from the parameters when adaptive
+    uint64_t n_retried;         // windows decoded again with the full context after a poor decode with an automatic one
+    float    last_decode_ms;    // time whisper took for the last window
+    uint64_t n_gated;           // steps the VAD gate kept from the decoder
+    int32_t  final_pending;     // utterances final_model has not finished or that were not passed on yet
+} stream_stats_t;
+
+void stream_get_stats(stream_context_t ctx, stream_stats_t *stats);
+
+// stream_run result once a replayed source has ended and all of it is decoded
+#define STREAM_RUN_END 1
+
+// text is passed to the callback as it is decoded, the new line callback is signalled by text == NULL
+// returns 0 to be called again, STREAM_RUN_END or an error code to stop
 typedef int (*stream_callback_t) (const char *text, int64_t t0, int64_t t1, void *ctx);
 int stream_run(stream_context_t ctx, void *callback_ctx, stream_callback_t callback);
 
+// With a final_model, the segments of params.model are all partial: the text
+// it committed stays in the partial segment until final_model has decoded
+// that utterance again, which then comes as final segments followed by the
+// partial segment of the rest.
+typedef enum stream_segment_kind {
+    STREAM_SEGMENT_PARTIAL = 0, // tentative text after the last final segment, replaces the previous partial one
+    STREAM_SEGMENT_FINAL   = 1, // text that will not change anymore, replaces the partial one and follows the previous final one
+} stream_segment_kind_t;
+
+typedef struct stream_segment {
+    stream_segment_kind_t kind;
+
+    const char *text; // never NULL, empty when a partial segment has no text left
+    int64_t t0;       // ms since the start of the stream
+    int64_t t1;
+
+    int32_t speaker;  // stream_params.speaker of the stream
+
+    const char *model; // stream_params.model or final_model, whichever produced the text
+} stream_segment_t;
+
+// the same as stream_run, with the text passed as partial and final segments
+typedef int (*stream_segment_callback_t) (const stream_segment_t *segment, void *ctx);
+int stream_run_segments(stream_context_t ctx, void *callback_ctx, stream_segment_callback_t callback);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <Segment.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct whisper_context;
+
+//
+// Offline transcription
+//
+// A recording is cut into chunks of at most chunk_ms at the silences found by
+// the streaming VAD, so no word is split between two chunks and long pauses
+// are not decoded at all. The chunks are independent and are decoded in
+// parallel by n_workers threads; the workers share the model weights and each
+// one only allocates its own whisper_state.
+//
+
+struct transcribe_params {
+    int32_t n_threads = std::max(1, (int32_t) std::thread::hardware_concurrency()); // in total, split between the workers
+    int32_t n_workers = 0;     // chunks decoded at the same time, 0 for one per 4 threads
+    int32_t chunk_ms  = 30000; // whisper decodes at most 30 s at once
+
+    float vad_thold  = 0.6f;
+    float freq_thold = 100.0f;
+
+    bool translate = false;
+
+    std::string language = "en";
+};
+
+// [begin, end) sample range of a chunk
+struct transcribe_chunk {
+    size_t begin;
+    size_t end;
+};
+
+// the chunks of pcmf32 that hold speech, in order
+std::vector<transcribe_chunk> transcribe_split(const std::vector<float> & pcmf32, const transcribe_params & params);
+
+// transcribe 16 kHz mono audio, segments are appended to result in order
+// returns false if the audio could not be decoded
+bool transcribe_pcm(
+        const std::shared_ptr<whisper_context> & model,
+        const std::vector<float> & pcmf32,
+        const transcribe_params & params,
+        OrderedSegments & result);
+
+// transcribe a WAV file, see read_wav()
+bool transcribe_file(
+        const std::shared_ptr<whisper_context> & model,
+        const std::string & fname,
+        const transcribe_params & params,
+        OrderedSegments & result);
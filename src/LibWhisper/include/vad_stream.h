@@ -0,0 +1,77 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Streaming voice activity detection
+//
+// Same energy criterion as vad_simple(), evaluated incrementally: every
+// captured sample goes through the high-pass filter once and updates running
+// energy sums over the reference window and its last part, so the cost per
+// block is O(block) instead of re-filtering and re-summing the whole window.
+//
+// vad_simple() fires when the last part of the window is quiet compared to
+// the whole window (speech just ended). The streaming detector reports that
+// falling edge as speech_end and the mirrored rising edge (first part quiet
+// compared to the whole window) as speech_start. Offsets are the index of
+// the sample at which the decision was taken, counted from the first sample
+// passed to process().
+//
+
+struct vad_stream_params {
+    int   sample_rate = 16000;
+    int   window_ms   = 2000;  // reference window, the amount of audio vad_simple() is given
+    int   last_ms     = 1000;  // part of the window compared against the whole
+    int   hold_ms     = 500;   // minimum distance between a speech_end and the following event
+    float vad_thold   = 0.6f;
+    float freq_thold  = 100.0f; // high-pass cutoff, 0 to disable the filter
+};
+
+struct vad_event {
+    enum vad_event_type {
+        speech_start,
+        speech_end,
+    } type;
+
+    uint64_t offset;
+};
+
+class vad_stream {
+public:
+    explicit vad_stream(const vad_stream_params & params = vad_stream_params());
+
+    // feed the next block of samples, appending the detected transitions to events
+    void process(const float * data, size_t n_samples, std::vector<vad_event> & events);
+
+    bool     speaking() const { return m_speaking; }
+    uint64_t position() const { return m_pos; }
+
+    void reset();
+
+private:
+    vad_stream_params m_params;
+
+    // high-pass filter state, the filter is the one of high_pass_filter()
+    float m_alpha  = 0.0f;
+    float m_y_prev = 0.0f;
+    std::vector<float> m_filtered;
+
+    // |filtered sample| history over the reference window
+    std::vector<float> m_energy;
+    size_t m_n_window = 0;
+    size_t m_n_last   = 0;
+
+    double m_sum_all  = 0.0;
+    double m_sum_last = 0.0;
+
+    uint64_t m_pos      = 0;
+    uint64_t m_pos_hold = 0; // no event before this position
+
+    bool m_speaking   = false;
+    bool m_start_prev = false;
+    bool m_end_prev   = false;
+};
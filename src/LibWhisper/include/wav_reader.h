@@ -0,0 +1,111 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include "dr_wav.h"
+
+#include <resampler.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//
+// Streaming WAV reader
+//
+// Decodes a WAV file, memory buffer or pipe block by block through dr_wav, so
+// memory use is one block regardless of the length of the recording. Samples
+// come out as float, either mixed down to mono or split per channel. Every
+// sample format dr_wav supports is converted through 16-bit PCM.
+//
+// Pipes cannot seek, so their header is parsed in dr_wav's sequential mode,
+// which only ever skips forward. Programs writing WAV to a pipe may leave the
+// data size at 0 because they do not know it yet; such a stream is read until
+// the pipe ends.
+//
+// set_sample_rate() converts recordings at any other rate to the one the
+// caller needs, through the resampler.
+//
+
+// input frames decoded at a time when resampling
+#define WAV_READER_RESAMPLE_BLOCK 4096
+
+class wav_reader {
+public:
+    wav_reader() = default;
+    ~wav_reader();
+
+    wav_reader(const wav_reader &) = delete;
+    wav_reader & operator=(const wav_reader &) = delete;
+
+    // fname is a path, "-" for stdin, or a buffer of WAV data (see is_wav_buffer())
+    bool open(const std::string & fname);
+
+    bool open_file(const std::string & path);
+
+    // data has to stay valid until the reader is closed
+    bool open_memory(const void * data, size_t size);
+
+    // reads from the current position of the stream, which is not closed with the reader
+    bool open_pipe(FILE * stream);
+
+    void close();
+
+    bool is_open() const { return m_open; }
+
+    // deliver the audio at sample_rate whatever the rate of the recording, call before the first read
+    void set_sample_rate(int sample_rate);
+
+    // the rate the audio is read at
+    int sample_rate() const { return m_sample_rate; }
+
+    // the rate of the recording
+    int source_sample_rate() const { return m_wav.sampleRate; }
+
+    int channels()    const { return m_wav.channels; }
+    int bits_per_sample() const { return m_wav.bitsPerSample; }
+
+    // length of the recording in frames at sample_rate(), 0 if unknown
+    uint64_t n_frames() const { return m_n_frames; }
+
+    // read up to n_frames frames mixed down to mono
+    // returns the number of frames read, less than n_frames only at the end of the data
+    size_t read(float * mono, size_t n_frames);
+
+    // the same, also splitting stereo into left and right (both are copies of mono for mono audio)
+    // when resampling, a reader has to stick to one of the two reads
+    size_t read(float * mono, float * left, float * right, size_t n_frames);
+
+private:
+    bool init(const char * source);
+
+    // read at the rate of the recording, left and right may be null
+    size_t read_native(float * mono, float * left, float * right, size_t n_frames);
+
+    // read up to n_frames frames into m_pcm16
+    size_t read_s16(size_t n_frames);
+
+    static size_t pipe_read(void * user_data, void * buf, size_t n_bytes);
+    static drwav_bool32 pipe_seek(void * user_data, int offset, drwav_seek_origin origin);
+
+    drwav m_wav {};
+    bool  m_open = false;
+
+    uint64_t m_n_frames = 0;
+
+    FILE *   m_pipe     = nullptr;
+    uint64_t m_pipe_pos = 0; // bytes read from the pipe
+
+    std::vector<uint8_t> m_data; // decoded by ffmpeg, for formats dr_wav cannot read
+    std::vector<int16_t> m_pcm16;
+
+    int m_sample_rate = 0;
+
+    // mono, left and right when resampling
+    resampler          m_resamplers[3];
+    std::vector<float> m_native[3];
+    std::vector<float> m_pending[3]; // resampled, not read yet
+    bool               m_eof = false;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct whisper_context;
+struct whisper_state;
+
+//
+// Read-only memory mapping of a model file
+//
+// whisper copies every tensor into its own backend buffers while loading, so
+// the mapping only spares the buffered reads and the staging copies of the
+// file; it is dropped as soon as the model is loaded. What stays behind are
+// the file's pages in the kernel's page cache, shared with every other process
+// reading the same file, which the kernel reclaims when it needs the memory.
+//
+
+struct whisper_model_params {
+    bool use_mmap  = true;  // load through a read-only mapping, otherwise let whisper read the file
+    bool willneed  = true;  // MADV_WILLNEED: start reading the whole file ahead
+    bool hugepages = false; // MADV_HUGEPAGE, where the kernel supports it for file mappings
+};
+
+class model_file {
+public:
+    // returns nullptr if the file cannot be mapped
+    static std::shared_ptr<model_file> open(const std::string & path, const whisper_model_params & params);
+
+    ~model_file();
+
+    model_file(const model_file &) = delete;
+    model_file & operator=(const model_file &) = delete;
+
+    const void * data() const { return m_data; }
+    size_t       size() const { return m_size; }
+
+private:
+    model_file() = default;
+
+    void * m_data = nullptr;
+    size_t m_size = 0;
+
+#ifdef _WIN32
+    void * m_file    = nullptr;
+    void * m_mapping = nullptr;
+#endif
+};
+
+//
+// Shared whisper models
+//
+// Model weights are loaded once per process and shared by every stream that
+// uses the same model file; each stream only allocates its own whisper_state
+// for decoding. The model is freed when the last stream using it goes away.
+//
+// Models are keyed by path and modification time, so a model file replaced on
+// disk is loaded again while streams still using the old one keep it. A
+// stream trims the cache when it is freed, which forgets the models nobody
+// uses any more; their files stay in the kernel's page cache until it needs
+// the memory, so restarting a stream or switching devices is usually a copy
+// from memory rather than a read from disk.
+//
+
+// load the model at path, or return the already loaded one
+// returns nullptr if the model cannot be loaded
+std::shared_ptr<whisper_context> whisper_model_acquire(const std::string & path, const whisper_model_params & params = whisper_model_params());
+
+// forget the models that are not in use
+void whisper_model_cache_trim();
+
+// lock the memory of the process, and with it the weights of the loaded models,
+// into RAM so they cannot be paged out between transcriptions; memory allocated
+// later, such as the states of streams started afterwards, is not locked
+// returns false if locking is not permitted (see RLIMIT_MEMLOCK) or not supported
+bool whisper_model_lock_memory();
+
+// a decoding state for model, keeping the model alive for as long as the state lives
+struct whisper_state_deleter {
+    std::shared_ptr<whisper_context> model;
+
+    void operator()(whisper_state * state) const;
+};
+
+using unique_whisper_state = std::unique_ptr<whisper_state, whisper_state_deleter>;
+
+unique_whisper_state whisper_model_new_state(const std::shared_ptr<whisper_context> & model);
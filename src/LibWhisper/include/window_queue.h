@@ -0,0 +1,76 @@
+#pragma once
+
+#include <LibWhisper.h>
+
+#include <stream.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+//
+// Analysis windows handed from the assembler thread to the decoder
+//
+
+// Only the capture ring positions of the audio are queued. The decoder copies
+// the samples out of the ring when it gets to the window, and then only those
+// its previous window did not have, see audio_window::slide().
+struct stream_window {
+    uint64_t begin = 0;        // capture ring index of the first sample
+    uint64_t end   = 0;        // one past the last one
+    bool     new_line = false; // last window of a line in fixed step mode
+    bool     degraded = false; // decode with reduced settings, the decoder is behind
+
+    size_t size() const { return end - begin; }
+};
+
+//
+// Bounded queue of analysis windows
+//
+// The producer never blocks: when the decoder falls behind and the queue is
+// full, the overflow policy decides what happens to the backlog and the
+// decision is counted, so dropped audio shows up in stream_get_stats()
+// instead of only on stderr. The capture ring has to hold the audio of every
+// queued window until the decoder gets to it.
+//
+
+class window_queue {
+public:
+    window_queue(size_t capacity, stream_overflow_policy_t policy, size_t n_max_samples);
+
+    // producer: queue a window, applying the overflow policy when full
+    void push(stream_window && window);
+
+    // consumer: wait up to timeout_ms for the next window
+    bool pop(stream_window & window, int timeout_ms);
+
+    // producer: wait up to timeout_ms until a window can be pushed without the overflow policy
+    bool wait_for_space(int timeout_ms);
+
+    // fills the queue related fields of stats
+    void get_stats(stream_stats_t & stats);
+
+private:
+    // merge window into the newest queued one, false if they cannot be merged
+    bool coalesce(stream_window & window);
+
+    const size_t                   m_capacity;
+    const stream_overflow_policy_t m_policy;
+    const size_t                   m_n_max_samples;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_cv_space;
+
+    std::deque<stream_window> m_queue;
+
+    size_t   m_depth_max   = 0;
+    uint64_t m_n_pushed    = 0;
+    uint64_t m_n_decoded   = 0;
+    uint64_t m_n_dropped   = 0;
+    uint64_t m_n_coalesced = 0;
+    uint64_t m_n_degraded  = 0;
+    uint64_t m_n_samples_dropped = 0;
+};
@@ -0,0 +1,98 @@
+#include "local_agreement.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+
+// token timestamps are rough, a token has to start this far before the commit point to count as committed
+#define LOCAL_AGREEMENT_TOLERANCE_SAMPLES 1600
+
+// longest run of committed tokens a new decode is checked for repeating
+#define LOCAL_AGREEMENT_MAX_NGRAM 5
+
+// committed tokens kept for the repeat check and the prompt
+#define LOCAL_AGREEMENT_HISTORY 256
+
+hypothesis_token hypothesis_token_from_whisper(int32_t id, std::string text, uint64_t begin, int64_t t0, int64_t t1) {
+    // a missing end must not wrap the unsigned position, nor end the token before it starts
+    return hypothesis_token {
+        id,
+        std::move(text),
+        begin + std::max<int64_t>(0, t0) * (WHISPER_SAMPLE_RATE / 100),
+        begin + std::max<int64_t>({ 0, t0, t1 }) * (WHISPER_SAMPLE_RATE / 100),
+    };
+}
+
+local_agreement::local_agreement(uint64_t pos) : m_pos_commit(pos) {}
+
+// whisper starts the first token of every word with a space
+static bool starts_word(const hypothesis_token & token) {
+    return token.text.empty() || token.text[0] == ' ';
+}
+
+void local_agreement::update(std::vector<hypothesis_token> && tokens, bool flush, std::vector<hypothesis_token> & committed) {
+    // the window may still start before the commit point, skip what was already committed from it
+    auto first = std::find_if(tokens.begin(), tokens.end(), [&](const hypothesis_token & token) {
+        return token.t0 + LOCAL_AGREEMENT_TOLERANCE_SAMPLES > m_pos_commit;
+    });
+    tokens.erase(tokens.begin(), first);
+
+    // a word cut by the commit point tends to be decoded again
+    const size_t n_max = std::min({ tokens.size(), m_history.size(), (size_t) LOCAL_AGREEMENT_MAX_NGRAM });
+    for (size_t n = n_max; n > 0; --n) {
+        const bool repeated = std::equal(tokens.begin(), tokens.begin() + n, m_history.end() - n, [](const hypothesis_token & a, const hypothesis_token & b) {
+            return a.id == b.id;
+        });
+
+        if (repeated) {
+            tokens.erase(tokens.begin(), tokens.begin() + n);
+            break;
+        }
+    }
+
+    if (flush) {
+        commit(tokens, tokens.size(), committed);
+        return;
+    }
+
+    // the prefix both decodes agree on
+    size_t n = 0;
+    while (n < tokens.size() && n < m_tentative.size() && tokens[n].id == m_tentative[n].id) {
+        ++n;
+    }
+
+    // do not commit half a word
+    while (n > 0 && n < tokens.size() && !starts_word(tokens[n])) {
+        --n;
+    }
+
+    commit(tokens, n, committed);
+}
+
+void local_agreement::advance(uint64_t pos) {
+    m_pos_commit = std::max(m_pos_commit, pos);
+    m_tentative.clear();
+}
+
+void local_agreement::prompt(std::vector<int32_t> & tokens, size_t n_max) const {
+    tokens.clear();
+
+    for (size_t i = m_history.size() - std::min(n_max, m_history.size()); i < m_history.size(); ++i) {
+        tokens.push_back(m_history[i].id);
+    }
+}
+
+void local_agreement::commit(std::vector<hypothesis_token> & tokens, size_t n, std::vector<hypothesis_token> & committed) {
+    if (n > 0) {
+        m_pos_commit = std::max(m_pos_commit, tokens[n - 1].t1);
+    }
+
+    committed.insert(committed.end(), tokens.begin(), tokens.begin() + n);
+    m_history.insert(m_history.end(), tokens.begin(), tokens.begin() + n);
+
+    if (m_history.size() > LOCAL_AGREEMENT_HISTORY) {
+        m_history.erase(m_history.begin(), m_history.end() - LOCAL_AGREEMENT_HISTORY);
+    }
+
+    m_tentative.assign(std::make_move_iterator(tokens.begin() + n), std::make_move_iterator(tokens.end()));
+}
@@ -0,0 +1,144 @@
+#define _USE_MATH_DEFINES // for M_PI
+
+#include "resampler.h"
+
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+// modified Bessel function of the first kind, order 0
+static double resampler_bessel_i0(double x) {
+    double sum  = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 64 && term > 1e-12*sum; k++) {
+        term *= (x/(2.0*k))*(x/(2.0*k));
+        sum  += term;
+    }
+
+    return sum;
+}
+
+resampler::resampler(int rate_in, int rate_out) : m_rate_in(rate_in), m_rate_out(rate_out) {
+    const uint64_t g = std::gcd(rate_in, rate_out);
+
+    m_up   = rate_out/g;
+    m_down = rate_in/g;
+
+    if (passthrough()) {
+        return;
+    }
+
+    // below 1 the cutoff follows the output's Nyquist frequency and the sinc widens with it
+    const double ratio = std::min(1.0, (double) m_up/m_down);
+    const double fc    = 0.5*ratio*RESAMPLER_ROLLOFF; // cycles per input sample
+
+    // a multiple of 16 taps keeps the dot product in the vector loops
+    m_n_taps   = 2*(int) std::ceil(RESAMPLER_ZERO_CROSSINGS/ratio);
+    m_n_taps   = (m_n_taps + 15)/16*16;
+    m_n_phases = (int) std::min<uint64_t>(m_up, RESAMPLER_MAX_PHASES);
+
+    const int    half = m_n_taps/2;
+    const double i0_beta = resampler_bessel_i0(RESAMPLER_KAISER_BETA);
+
+    m_filter.resize((size_t) (m_n_phases + 1)*m_n_taps);
+
+    for (int p = 0; p <= m_n_phases; p++) {
+        float * h = m_filter.data() + (size_t) p*m_n_taps;
+
+        double sum = 0.0;
+        for (int j = 0; j < m_n_taps; j++) {
+            // distance from the output sample to tap j, in input samples
+            const double d = (half - 1 - j) + (double) p/m_n_phases;
+
+            const double x = d/half;
+            const double w = std::fabs(x) < 1.0 ? resampler_bessel_i0(RESAMPLER_KAISER_BETA*std::sqrt(1.0 - x*x))/i0_beta : 0.0;
+            const double s = d == 0.0 ? 1.0 : std::sin(M_PI*2.0*fc*d)/(M_PI*2.0*fc*d);
+
+            h[j] = (float) (s*w);
+            sum += s*w;
+        }
+
+        // unity gain at DC for every phase
+        for (int j = 0; j < m_n_taps; j++) {
+            h[j] = (float) (h[j]/sum);
+        }
+    }
+
+    reset();
+}
+
+size_t resampler::max_output(size_t n_in) const {
+    if (passthrough()) {
+        return n_in;
+    }
+
+    // the output ends with the last sample that falls before the end of the input
+    return ((m_n_in + n_in)*m_up + m_down - 1)/m_down - m_n_out;
+}
+
+size_t resampler::process(const float * in, size_t n_in, float * out) {
+    if (passthrough()) {
+        memcpy(out, in, n_in*sizeof(float));
+        return n_in;
+    }
+
+    m_buf.insert(m_buf.end(), in, in + n_in);
+    m_n_in += n_in;
+
+    return run(out, UINT64_MAX);
+}
+
+size_t resampler::flush(float * out) {
+    if (passthrough()) {
+        return 0;
+    }
+
+    // silence for the look-ahead of the last samples, which must not add samples of its own
+    m_buf.resize(m_buf.size() + m_n_taps, 0.0f);
+
+    const size_t n = run(out, max_output(0));
+
+    reset();
+
+    return n;
+}
+
+void resampler::reset() {
+    // history of zeros, so the first output sample lines up with the first input sample
+    m_buf.assign(m_n_taps/2 - 1, 0.0f);
+    m_pos  = 0;
+    m_frac = 0;
+
+    m_n_in  = 0;
+    m_n_out = 0;
+}
+
+size_t resampler::run(float * out, uint64_t n_max) {
+    const auto & dsp = dsp_get_kernels();
+
+    const bool exact = (uint64_t) m_n_phases == m_up;
+
+    size_t n = 0;
+    while (n < n_max && m_pos + m_n_taps <= m_buf.size()) {
+        const uint64_t phase = exact ? m_frac : (m_frac*m_n_phases + m_up/2)/m_up;
+
+        out[n++] = dsp.dot(m_buf.data() + m_pos, m_filter.data() + phase*m_n_taps, m_n_taps);
+
+        m_frac += m_down;
+        m_pos  += m_frac/m_up;
+        m_frac %= m_up;
+    }
+
+    m_n_out += n;
+
+    // drop the input no output needs anymore, the position may already be past what arrived
+    const size_t n_drop = std::min(m_pos, m_buf.size());
+    m_buf.erase(m_buf.begin(), m_buf.begin() + n_drop);
+    m_pos -= n_drop;
+
+    return n;
+}
@@ -0,0 +1,46 @@
+#include "rtf_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// std::clamp, but the lower bound wins where the bounds cross instead of being undefined
+static int clamp_bounds(double value, int lo, int hi) {
+    return std::max<double>(lo, std::min<double>(value, hi));
+}
+
+bool rtf_controller_fit_bounds(rtf_controller_params & params, int step_ms, int length_ms) {
+    const rtf_controller_params bounds = params;
+
+    params.step_ms_min   = std::min(params.step_ms_min, step_ms);
+    params.step_ms_max   = std::max({ params.step_ms_max, step_ms, params.step_ms_min });
+    params.length_ms_min = std::clamp(params.length_ms_min, params.step_ms_min, length_ms);
+    params.length_ms_max = std::max({ params.length_ms_max, length_ms, params.length_ms_min });
+
+    return params.step_ms_min == bounds.step_ms_min && params.step_ms_max == bounds.step_ms_max &&
+           params.length_ms_min == bounds.length_ms_min && params.length_ms_max == bounds.length_ms_max;
+}
+
+rtf_controller::rtf_controller(const rtf_controller_params & params, int step_ms, int length_ms)
+    : m_params(params),
+      m_length_ms_pref(clamp_bounds(length_ms, params.length_ms_min, params.length_ms_max)),
+      m_step_ms(clamp_bounds(step_ms, params.step_ms_min, params.step_ms_max)),
+      m_length_ms(m_length_ms_pref) {}
+
+void rtf_controller::update(double decode_ms, double audio_ms) {
+    if (audio_ms <= 0.0) {
+        return;
+    }
+
+    const float rtf = decode_ms / audio_ms;
+    m_rtf = m_rtf == 0.0f ? rtf : m_rtf + m_params.smoothing * (rtf - m_rtf);
+
+    // longest window the slowest step can still keep up with
+    const double length_ms_max = m_params.target_load * m_params.step_ms_max / m_rtf;
+
+    m_length_ms = clamp_bounds(std::min<double>(m_length_ms_pref, length_ms_max), m_params.length_ms_min, m_params.length_ms_max);
+
+    // shortest step that leaves the decoder enough time, in 100 ms increments so it does not jitter
+    const double step_ms = m_rtf * m_length_ms / m_params.target_load;
+
+    m_step_ms = clamp_bounds(100 * std::ceil(step_ms / 100.0), m_params.step_ms_min, std::min(m_params.step_ms_max, m_length_ms));
+}
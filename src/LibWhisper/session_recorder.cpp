@@ -0,0 +1,223 @@
+#include "session_recorder.h"
+
+#include "dsp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+session_recorder::~session_recorder() {
+    close();
+}
+
+bool session_recorder::open(const std::string & path, const audio_ring & ring, int sample_rate, int checkpoint_ms) {
+    close();
+
+    m_file = fopen(path.c_str(), "wb");
+    if (m_file == nullptr) {
+        fprintf(stderr, "%s: failed to open '%s' for writing\n", __func__, path.c_str());
+        return false;
+    }
+
+    // the buffer already collects whole seconds of audio, stdio would only copy it once more
+    setvbuf(m_file, nullptr, _IONBF, 0);
+
+    m_path = path;
+    m_sample_rate = sample_rate;
+    m_checkpoint_ms = checkpoint_ms;
+    m_ring = &ring;
+    m_cursor = ring.make_cursor();
+
+    m_buffer.reset(new (std::align_val_t(4096)) int16_t[SESSION_RECORDER_BUFFER_SAMPLES]);
+    m_n_buffered = 0;
+    m_n_written = 0;
+    m_n_lost = 0;
+    m_checkpoint = false;
+
+    // sizes of 0 until the first checkpoint, which readers of pipes take as "until the end"
+    if (!write_header()) {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    fprintf(stderr, "%s: recording the session to '%s'\n", __func__, path.c_str());
+
+    m_thread = std::jthread([this](std::stop_token stoken) { run(stoken); });
+
+    return true;
+}
+
+bool session_recorder::close() {
+    if (m_file == nullptr) {
+        return true;
+    }
+
+    if (m_thread.joinable()) {
+        m_thread.request_stop();
+        m_thread.join();
+    }
+
+    // whatever arrived after the writer's last wakeup
+    const bool ok = drain() && flush(true);
+
+    fclose(m_file);
+    m_file = nullptr;
+    m_buffer.reset();
+
+    fprintf(stderr, "%s: recorded %.1f s to '%s'", __func__, (double) m_n_written / m_sample_rate, m_path.c_str());
+    if (m_n_lost > 0) {
+        fprintf(stderr, ", %.1f s of it lost and replaced by silence", (double) m_n_lost / m_sample_rate);
+    }
+    fprintf(stderr, "\n");
+
+    return ok;
+}
+
+void session_recorder::checkpoint() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_checkpoint = true;
+    }
+
+    m_cv.notify_all();
+}
+
+void session_recorder::run(std::stop_token stoken) {
+    using clock = std::chrono::steady_clock;
+
+    auto t_checkpoint = clock::now();
+
+    while (!stoken.stop_requested()) {
+        bool checkpoint = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, stoken, std::chrono::milliseconds(SESSION_RECORDER_POLL_MS), [&] { return m_checkpoint; });
+
+            checkpoint = m_checkpoint;
+            m_checkpoint = false;
+        }
+
+        if (stoken.stop_requested()) {
+            break;
+        }
+
+        if (!drain()) {
+            break;
+        }
+
+        const auto t_now = clock::now();
+        if (checkpoint || t_now - t_checkpoint >= std::chrono::milliseconds(m_checkpoint_ms)) {
+            if (!flush(true)) {
+                break;
+            }
+
+            t_checkpoint = t_now;
+        }
+    }
+}
+
+bool session_recorder::drain() {
+    const auto & dsp = dsp_get_kernels();
+
+    while (true) {
+        const uint64_t n_lost = m_cursor.n_lost;
+
+        const auto audio = m_ring->read(m_cursor, SESSION_RECORDER_BUFFER_SAMPLES - m_n_buffered);
+
+        // silence in place of what the ring dropped before it was read, then read again
+        if (m_cursor.n_lost > n_lost) {
+            uint64_t n_gap = m_cursor.n_lost - n_lost;
+            m_n_lost += n_gap;
+
+            while (n_gap > 0) {
+                const size_t n = std::min<uint64_t>(n_gap, SESSION_RECORDER_BUFFER_SAMPLES - m_n_buffered);
+                memset(m_buffer.get() + m_n_buffered, 0, n*sizeof(int16_t));
+                m_n_buffered += n;
+                n_gap -= n;
+
+                if (m_n_buffered == SESSION_RECORDER_BUFFER_SAMPLES && !flush(false)) {
+                    return false;
+                }
+            }
+
+            continue;
+        }
+
+        if (audio.empty()) {
+            return true;
+        }
+
+        int16_t * dst = m_buffer.get() + m_n_buffered;
+        dsp.f32_to_s16(audio.first.data(),  dst,                       audio.first.size());
+        dsp.f32_to_s16(audio.second.data(), dst + audio.first.size(), audio.second.size());
+
+        // the producer may have lapped the oldest samples while they were converted
+        const size_t n_overwritten = m_ring->n_overwritten(audio);
+        if (n_overwritten > 0) {
+            memset(dst, 0, n_overwritten*sizeof(int16_t));
+            m_n_lost += n_overwritten;
+        }
+
+        m_ring->consume(m_cursor, audio.size());
+        m_n_buffered += audio.size();
+
+        if (m_n_buffered == SESSION_RECORDER_BUFFER_SAMPLES && !flush(false)) {
+            return false;
+        }
+    }
+}
+
+bool session_recorder::flush(bool update_header) {
+    if (m_n_buffered > 0) {
+        if (fwrite(m_buffer.get(), sizeof(int16_t), m_n_buffered, m_file) != m_n_buffered) {
+            fprintf(stderr, "%s: failed to write to '%s', recording stopped\n", __func__, m_path.c_str());
+            return false;
+        }
+
+        m_n_written += m_n_buffered;
+        m_n_buffered = 0;
+    }
+
+    if (update_header) {
+        if (!write_header() || fseek(m_file, 0, SEEK_END) != 0) {
+            fprintf(stderr, "%s: failed to update the header of '%s', recording stopped\n", __func__, m_path.c_str());
+            return false;
+        }
+
+        fflush(m_file);
+    }
+
+    return true;
+}
+
+bool session_recorder::write_header() {
+    // RIFF sizes are 32-bit, a longer recording keeps the largest size it can declare
+    const uint32_t data_size = (uint32_t) std::min<uint64_t>(m_n_written*sizeof(int16_t), UINT32_MAX - 36);
+
+    const uint32_t riff_size       = 36 + data_size;
+    const uint32_t fmt_size        = 16;
+    const uint16_t audio_format    = 1; // PCM
+    const uint16_t channels        = 1;
+    const uint32_t sample_rate     = m_sample_rate;
+    const uint16_t bits_per_sample = 16;
+    const uint32_t byte_rate       = sample_rate*channels*bits_per_sample/8;
+    const uint16_t block_align     = channels*bits_per_sample/8;
+
+    uint8_t header[44];
+    memcpy(header +  0, "RIFF", 4);
+    memcpy(header +  4, &riff_size, 4);
+    memcpy(header +  8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    memcpy(header + 16, &fmt_size, 4);
+    memcpy(header + 20, &audio_format, 2);
+    memcpy(header + 22, &channels, 2);
+    memcpy(header + 24, &sample_rate, 4);
+    memcpy(header + 28, &byte_rate, 4);
+    memcpy(header + 32, &block_align, 2);
+    memcpy(header + 34, &bits_per_sample, 2);
+    memcpy(header + 36, "data", 4);
+    memcpy(header + 40, &data_size, 4);
+
+    return fseek(m_file, 0, SEEK_SET) == 0 && fwrite(header, 1, sizeof(header), m_file) == sizeof(header);
+}
@@ -3,61 +3,409 @@
 
 #include "common.h"
 #include "common-sdl.h"
+#include "capture_source.h"
+#include "audio_window.h"
+#include "window_queue.h"
+#include "vad_stream.h"
+#include "whisper_model.h"
+#include "rtf_controller.h"
+#include "local_agreement.h"
+#include "session_recorder.h"
+#include "cpu_topology.h"
+#include "final_decoder.h"
 #include "SDL3/SDL.h"
 #include "whisper.h"
 #include "stream.h"
 
+#include <atomic>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <deque>
 #include <string>
 #include <thread>
 #include <vector>
 #include <fstream>
+#include <optional>
 
-using unique_whisper = std::unique_ptr<whisper_context, std::integral_constant<decltype(&whisper_free), &whisper_free>>;
+// upper bound on how long stream_run blocks waiting for audio before returning to the caller
+#define STREAM_WAIT_TIMEOUT_MS 100
+
+// committed tokens used as the prompt in incremental mode
+#define STREAM_PROMPT_MAX_TOKENS 128
+
+// audio the capture ring keeps on top of the window for final_model to catch up with
+#define STREAM_CASCADE_RING_MS 60000
+
+// longest utterance final_model decodes at once, incremental mode
+#define STREAM_CASCADE_UTTERANCE_MS 15000
+
+// average token log probability below which a decode with a reduced audio context is retried with the full one
+#define STREAM_AUDIO_CTX_LOGPROB_THOLD -1.0f
 
 struct stream_context {
     stream_params params;
     std::unique_ptr<audio_async> audio;
-    unique_whisper whisper;
-    std::vector<float> pcmf32;
-    std::vector<float> pcmf32_old;
-    std::vector<float> pcmf32_new;
+    std::unique_ptr<session_recorder> recorder; // stopped before the capture ring it follows goes away
+    std::shared_ptr<whisper_context> whisper;
+    unique_whisper_state state;
+    std::unique_ptr<window_queue> queue;
     std::vector<whisper_token> prompt_tokens;
-    std::chrono::time_point<std::chrono::high_resolution_clock> t_last;
-    std::chrono::time_point<std::chrono::high_resolution_clock> t_start;
-    int n_samples_step;
-    int n_samples_len;
+
+    // window assembly, owned by the assembler thread
+    audio_ring::cursor cursor;
+    uint64_t pos_window = 0; // capture ring index where the window starts, it ends at the cursor
+    vad_stream vad;
+    std::vector<vad_event> vad_events;
+    uint64_t pos_speech = UINT64_MAX; // capture ring index where the current utterance started
+    std::atomic<uint64_t> n_samples_lost = 0;
+    int n_iter = 0; // steps since the last new line
+    std::atomic_bool drained = false; // the source has ended and its last window is queued
+    bool lossless = false; // replay as fast as possible: wait for the decoder instead of dropping windows
+    bool gate_open = false; // the last step had speech, params.vad_gate
+    std::atomic<uint64_t> n_gated = 0;
+
+    // window being decoded, owned by stream_run
+    stream_window current;
+    audio_window samples; // of the current window, copied out of the capture ring as it slides
+    std::optional<local_agreement> agreement;
+    std::vector<hypothesis_token> tokens;
+    std::vector<hypothesis_token> committed;
+    std::string text;
+
+    // capture ring index before which the decoder has committed everything, incremental mode
+    std::atomic<uint64_t> pos_commit = 0;
+
+    uint64_t pos_start; // capture ring index of t = 0
+    int32_t warmup_ms = 0;
+    std::atomic<int> n_samples_step; // retuned by the controller while the assembler runs
+    std::atomic<int> n_samples_len;
     int n_samples_keep;
+    int n_samples_vad_block;
+    int n_samples_vad_last;
     bool use_vad;
-    int n_new_line;
-    int n_iter = 0;
+    std::optional<rtf_controller> controller;
+    std::atomic<float> rtf = 0.0f;
+    std::atomic<uint64_t> n_retried = 0;
+    std::atomic<float> last_decode_ms = 0.0f;
+
+    // cascade: the final model, and what the fast one has that the final one did not pass on yet
+    std::unique_ptr<final_decoder> finals; // stopped before the capture ring it reads goes away
+    std::deque<final_job> drafts; // pushed to finals and not popped, in order
+    std::string utterance;        // committed since pos_final and not pushed yet, incremental mode
+    std::string tentative;        // past the committed text
+    uint64_t pos_final = 0;       // capture ring index where the next utterance starts
+    uint64_t pos_tentative = 0;   // end of the tentative text
+
+    // cores of the threads, all empty without a placement
+    cpu_placement placement;
+    std::thread::id decoder; // the thread last pinned to placement.decode
+
+    // declared last so it is stopped before anything it uses goes away
+    std::jthread assembler;
 };
 
 struct stream_params stream_default_params() {
     return stream_params {
-        /* .n_threads     =*/ std::min(4, (int32_t) std::thread::hardware_concurrency()),
-        /* .step_ms       =*/ 3000,
-        /* .length_ms     =*/ 10000,
-        /* .keep_ms       =*/ 200,
-        /* .capture_id    =*/ -1,
-        /* .max_tokens    =*/ 32,
-        /* .audio_ctx     =*/ 0,
-
-        /* .vad_thold     =*/ 0.6f,
-        /* .freq_thold    =*/ 100.0f,
-
-        /* .speed_up      =*/ false,
-        /* .translate     =*/ false,
-        /* .print_special =*/ false,
-        /* .no_context    =*/ true,
-        /* .no_timestamps =*/ false,
-
-        /* .language      =*/ "en",
-        /* .model         =*/ "models/ggml-base.en.bin"
+        /* .n_threads       =*/ std::min(4, (int32_t) std::thread::hardware_concurrency()),
+        /* .step_ms         =*/ 3000,
+        /* .length_ms       =*/ 10000,
+        /* .keep_ms         =*/ 200,
+        /* .capture_id      =*/ -1,
+        /* .max_tokens      =*/ 32,
+        /* .audio_ctx       =*/ STREAM_AUDIO_CTX_AUTO,
+        /* .queue_depth     =*/ 2,
+        /* .channel         =*/ -1,
+        /* .speaker         =*/ 0,
+        /* .final_n_threads =*/ 0,
+        /* .step_ms_min     =*/ 1000,
+        /* .step_ms_max     =*/ 5000,
+        /* .length_ms_min   =*/ 5000,
+        /* .length_ms_max   =*/ 15000,
+
+        /* .overflow_policy =*/ STREAM_OVERFLOW_COALESCE,
+        /* .placement       =*/ STREAM_PLACEMENT_NONE,
+
+        /* .vad_thold       =*/ 0.6f,
+        /* .freq_thold      =*/ 100.0f,
+        /* .source_speed    =*/ 1.0f,
+
+        /* .speed_up        =*/ false,
+        /* .translate       =*/ false,
+        /* .print_special   =*/ false,
+        /* .no_context      =*/ true,
+        /* .no_timestamps   =*/ false,
+        /* .warmup          =*/ true,
+        /* .lock_memory     =*/ false,
+        /* .adaptive        =*/ true,
+        /* .incremental     =*/ false,
+        /* .vad_gate        =*/ false,
+
+        /* .language        =*/ "en",
+        /* .model           =*/ "models/ggml-base.en.bin",
+        /* .final_model     =*/ NULL,
+        /* .source          =*/ NULL,
+        /* .record          =*/ NULL,
     };
 }
 
+// encoder context that covers n_samples, whisper's full context is 1500 positions for 30 s
+static int stream_audio_ctx(int n_samples) {
+    // a margin of 64 positions (1.28 s), whisper degrades when the speech runs up to the end of the context
+    const int n_ctx = (n_samples + 319) / 320 + 64;
+
+    // only a few sizes, so the encoder graph of the state is re-planned for a handful of shapes
+    // instead of on every window; the smallest one also keeps very short windows from degrading
+    for (int bucket : { 256, 384, 512, 768, 1024 }) {
+        if (n_ctx <= bucket) {
+            return bucket;
+        }
+    }
+
+    return 1500;
+}
+
+// mean log probability of the text tokens of the last decode, 0 without text
+static float stream_avg_logprob(whisper_context *whisper, whisper_state *state) {
+    const whisper_token token_eot = whisper_token_eot(whisper);
+
+    float sum = 0.0f;
+    int n = 0;
+
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; ++i) {
+        const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            const whisper_token_data data = whisper_full_get_token_data_from_state(state, i, j);
+            if (data.id < token_eot) {
+                sum += data.plog;
+                ++n;
+            }
+        }
+    }
+
+    return n > 0 ? sum / n : 0.0f;
+}
+
+// samples in the window being assembled
+static size_t stream_window_size(const stream_context *ctx) {
+    return ctx->cursor.pos - ctx->pos_window;
+}
+
+// drop all but the newest n samples of the window being assembled
+static void stream_window_keep(stream_context *ctx, size_t n) {
+    ctx->pos_window = ctx->cursor.pos - std::min<uint64_t>(stream_window_size(ctx), n);
+}
+
+// fixed step mode: slide the window by one step and queue it
+static void stream_assemble_step(stream_context *ctx) {
+    // sleep until the capture callback signals a full step
+    const int n_samples_step = ctx->n_samples_step;
+    const int n_samples_len = ctx->n_samples_len;
+
+    // leave the audio in the ring until the decoder catches up, which holds back the replay
+    if (ctx->lossless && !ctx->queue->wait_for_space(STREAM_WAIT_TIMEOUT_MS)) {
+        return;
+    }
+
+    // checked first: once a replayed source has finished, all of its audio is in the ring
+    const bool finished = ctx->audio->finished();
+
+    if (!ctx->audio->wait(ctx->cursor, n_samples_step, STREAM_WAIT_TIMEOUT_MS) && !finished) {
+        return;
+    }
+
+    // without dropping, one step at a time
+    const auto audio_new = ctx->audio->read(ctx->cursor, ctx->lossless ? n_samples_step : SIZE_MAX);
+    const bool last = finished && audio_new.end() == ctx->audio->ring().head();
+    ctx->n_samples_lost = ctx->cursor.n_lost;
+
+    const bool incremental = ctx->params.incremental;
+
+    // keep up to params.length_ms (+ keep_ms) of audio from previous iterations, the new samples always
+    // the audio stays in the ring, only the decoder copies it out
+    ctx->audio->ring().consume(ctx->cursor, audio_new.size());
+    stream_window_keep(ctx, std::max<size_t>(incremental ? n_samples_len : ctx->n_samples_keep + n_samples_len, audio_new.size()));
+
+    if (incremental) {
+        // the decoder no longer needs the audio of the committed text
+        const uint64_t pos_commit = std::min<uint64_t>(ctx->pos_commit, ctx->cursor.pos);
+        stream_window_keep(ctx, ctx->cursor.pos - pos_commit);
+    }
+
+    // number of steps to print new line
+    const int n_new_line = std::max(1, n_samples_len / n_samples_step - 1);
+
+    bool gate_closed = false;
+    if (ctx->params.vad_gate) {
+        ctx->vad.process(audio_new.first.data(), audio_new.first.size(), ctx->vad_events);
+        ctx->vad.process(audio_new.second.data(), audio_new.second.size(), ctx->vad_events);
+
+        const bool speech = ctx->vad.speaking() || !ctx->vad_events.empty();
+        ctx->vad_events.clear();
+
+        if (!speech && !ctx->gate_open && !last) {
+            // the detector notices speech late, keep enough for the start of the next utterance
+            stream_window_keep(ctx, ctx->n_samples_keep + ctx->n_samples_vad_last);
+            ctx->n_iter = 0;
+            ++ctx->n_gated;
+            return;
+        }
+
+        // the first step without speech still goes out, to end the line
+        gate_closed = !speech;
+        ctx->gate_open = speech;
+    }
+
+    ++ctx->n_iter;
+
+    if (last && stream_window_size(ctx) == 0) {
+        ctx->drained = true;
+        return;
+    }
+
+    stream_window window;
+    window.begin = ctx->pos_window;
+    window.end = ctx->cursor.pos;
+
+    // in incremental mode a line ends when nothing was committed for a whole window
+    window.new_line = incremental ? window.size() >= (size_t) n_samples_len : ctx->n_iter >= n_new_line;
+    window.new_line |= last || gate_closed;
+
+    if (window.new_line) {
+        // keep part of the audio for next iteration to try to mitigate word boundary issues
+        stream_window_keep(ctx, ctx->n_samples_keep);
+        ctx->n_iter = 0;
+    }
+
+    ctx->queue->push(std::move(window));
+
+    // only after the push, so stream_run finds the last window before it sees the end
+    ctx->drained = last;
+}
+
+// VAD mode: queue the utterance that ends at pos
+static void stream_queue_utterance(stream_context *ctx, uint64_t pos) {
+    // without a start, speech began before the stream did: take the last params.length_ms
+    uint64_t begin = pos - std::min<uint64_t>(pos - ctx->pos_start, ctx->n_samples_len);
+    if (ctx->pos_speech != UINT64_MAX) {
+        begin = std::max(begin, ctx->pos_speech);
+    }
+    ctx->pos_speech = UINT64_MAX;
+
+    stream_window window;
+    window.begin = begin;
+    window.end = pos;
+    window.new_line = true;
+
+    ctx->queue->push(std::move(window));
+}
+
+// VAD mode: run the streaming VAD over each captured block once and queue
+// the utterance as soon as speech ends
+static void stream_assemble_vad(stream_context *ctx) {
+    if (ctx->lossless && !ctx->queue->wait_for_space(STREAM_WAIT_TIMEOUT_MS)) {
+        return;
+    }
+
+    // checked first: once a replayed source has finished, all of its audio is in the ring
+    const bool finished = ctx->audio->finished();
+
+    if (!ctx->audio->wait(ctx->cursor, ctx->n_samples_vad_block, STREAM_WAIT_TIMEOUT_MS) && !finished) {
+        return;
+    }
+
+    // without dropping, one block at a time, so at most one utterance ends per call
+    const auto audio = ctx->audio->read(ctx->cursor, ctx->lossless ? ctx->n_samples_vad_block : SIZE_MAX);
+    const bool last = finished && audio.end() == ctx->audio->ring().head();
+    ctx->n_samples_lost = ctx->cursor.n_lost;
+
+    ctx->vad.process(audio.first.data(), audio.first.size(), ctx->vad_events);
+    ctx->vad.process(audio.second.data(), audio.second.size(), ctx->vad_events);
+    ctx->audio->ring().consume(ctx->cursor, audio.size());
+
+    for (const auto & event : ctx->vad_events) {
+        const uint64_t pos = ctx->pos_start + event.offset;
+
+        if (event.type == vad_event::speech_start) {
+            // the detector only notices speech once it dominates the last part of its window
+            ctx->pos_speech = pos - std::min<uint64_t>(pos - ctx->pos_start, ctx->n_samples_vad_last);
+            continue;
+        }
+
+        stream_queue_utterance(ctx, pos);
+    }
+
+    ctx->vad_events.clear();
+
+    if (last) {
+        // the recording ended while someone was still speaking
+        if (ctx->pos_speech != UINT64_MAX) {
+            stream_queue_utterance(ctx, ctx->cursor.pos);
+        }
+
+        ctx->drained = true;
+    }
+}
+
+// decoding parameters shared by every window of the stream
+static whisper_full_params stream_whisper_params(const stream_context *ctx) {
+    const auto & params = ctx->params;
+
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+
+    wparams.print_progress = false;
+    wparams.print_special = params.print_special;
+    wparams.print_realtime = false;
+    wparams.print_timestamps = !params.no_timestamps;
+    wparams.translate = params.translate;
+    wparams.no_context = true;
+    wparams.single_segment = !ctx->use_vad;
+    wparams.max_tokens = params.max_tokens;
+    wparams.language = params.language;
+    wparams.n_threads = params.n_threads;
+
+    wparams.audio_ctx = std::max(0, params.audio_ctx);
+    //wparams.speed_up = params.speed_up; // this is no longer a parameter
+
+    // disable temperature fallback
+    wparams.temperature_inc = -1.0f;
+
+    return wparams;
+}
+
+// pin the calling thread to the decoder's cores before it runs whisper, ggml creates its workers from it
+static void stream_place_decoder(stream_context *ctx) {
+    if (ctx->placement.decode.empty() || ctx->decoder == std::this_thread::get_id()) {
+        return;
+    }
+
+    cpu_pin_thread(ctx->placement.decode);
+    ctx->decoder = std::this_thread::get_id();
+}
+
+// run a second of silence through the model, so allocating the compute graph,
+// faulting in the weights and warming the caches happens before the first real
+// window instead of delaying the first transcript
+static void stream_warmup(stream_context *ctx) {
+    const auto t_begin = std::chrono::high_resolution_clock::now();
+
+    const std::vector<float> silence(WHISPER_SAMPLE_RATE, 0.0f);
+
+    stream_place_decoder(ctx);
+
+    whisper_full_params wparams = stream_whisper_params(ctx);
+    wparams.max_tokens = 1;
+
+    if (whisper_full_with_state(ctx->whisper.get(), ctx->state.get(), wparams, silence.data(), silence.size()) != 0) {
+        fprintf(stderr, "%s: warmup failed\n", __func__);
+    }
+
+    ctx->warmup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t_begin).count();
+
+    fprintf(stderr, "%s: model warmed up in %d ms\n", __func__, ctx->warmup_ms);
+}
+
 stream_context *stream_init(stream_params params) {
     auto ctx = std::make_unique<stream_context>();
 
@@ -71,171 +419,639 @@ stream_context *stream_init(stream_params params) {
 
     ctx->use_vad = ctx->n_samples_step <= 0; // sliding window mode uses VAD
 
-    ctx->n_new_line = !ctx->use_vad ? std::max(1, params.length_ms / params.step_ms - 1) : 1; // number of steps to print new line
+    if (!ctx->use_vad && params.adaptive) {
+        rtf_controller_params cparams;
+        cparams.step_ms_min   = params.step_ms_min;
+        cparams.step_ms_max   = params.step_ms_max;
+        cparams.length_ms_min = params.length_ms_min;
+        cparams.length_ms_max = params.length_ms_max;
+
+        // the controller starts from the configured step and length, the bounds are widened to hold them
+        if (!rtf_controller_fit_bounds(cparams, params.step_ms, params.length_ms)) {
+            fprintf(stderr, "%s: WARNING: adaptive bounds widened to step %d-%d ms, length %d-%d ms to hold step %d ms, length %d ms\n", __func__,
+                    cparams.step_ms_min, cparams.step_ms_max, cparams.length_ms_min, cparams.length_ms_max, params.step_ms, params.length_ms);
+        }
+
+        params.step_ms_min   = cparams.step_ms_min;
+        params.step_ms_max   = cparams.step_ms_max;
+        params.length_ms_min = cparams.length_ms_min;
+        params.length_ms_max = cparams.length_ms_max;
+
+        ctx->controller.emplace(cparams, params.step_ms, params.length_ms);
+    }
 
+    params.incremental &= !ctx->use_vad;
+    params.vad_gate &= !ctx->use_vad;
     params.no_timestamps = !ctx->use_vad;
     params.no_context |= ctx->use_vad;
     params.max_tokens = 0;
 
-    // init audio
-    ctx->audio = std::make_unique<audio_async>(params.length_ms);
-    if (!ctx->audio->init(params.capture_id, WHISPER_SAMPLE_RATE)) {
+    // init audio, the capture buffer has to hold the longest window the controller may pick, the audio
+    // of the windows queued behind it and in cascade mode the utterances the final model has yet to get to
+    {
+        const int length_ms_max = ctx->controller ? std::max(params.length_ms, params.length_ms_max) : params.length_ms;
+        const int step_ms_max   = ctx->controller ? std::max(params.step_ms, params.step_ms_max) : params.step_ms;
+
+        // queued utterances do not overlap, queued steps mostly do, and coalesced ones grow up to 30 s
+        int backlog_ms = (std::max(params.queue_depth, 1) + 1) * (ctx->use_vad ? length_ms_max : step_ms_max);
+        if (params.overflow_policy == STREAM_OVERFLOW_COALESCE) {
+            backlog_ms = std::max(backlog_ms, 30000);
+        }
+
+        ctx->audio = std::make_unique<audio_async>(params.keep_ms + length_ms_max + backlog_ms + (params.final_model != NULL ? STREAM_CASCADE_RING_MS : 0));
+    }
+    ctx->lossless = params.source != NULL && params.source_speed <= 0.0f;
+
+    std::unique_ptr<capture_source> source;
+    if (params.source != NULL) {
+        source = std::make_unique<file_capture_source>(params.source, params.source_speed, params.channel);
+    } else {
+        source = std::make_unique<sdl_capture_source>(params.capture_id, params.channel);
+    }
+
+    if (!ctx->audio->init(std::move(source), WHISPER_SAMPLE_RATE)) {
         fprintf(stderr, "%s: audio.init() failed!\n", __func__);
         return NULL;
     }
 
-    ctx->audio->resume();
-
     // whisper init
     if (whisper_lang_id(params.language) == -1) {
         fprintf(stderr, "%s: unknown language '%s'\n", __func__, params.language);
         return NULL;
     }
 
-    if ((ctx->whisper = unique_whisper(whisper_init_from_file_with_params(params.model, whisper_context_default_params()))) == NULL) {
+    // the weights are shared with other streams using the same model, only the state is ours
+    if ((ctx->whisper = whisper_model_acquire(params.model)) == NULL) {
+        return NULL;
+    }
+
+    if ((ctx->state = whisper_model_new_state(ctx->whisper)) == NULL) {
+        fprintf(stderr, "%s: failed to allocate whisper state\n", __func__);
         return NULL;
     }
 
-    ctx->pcmf32 = std::vector<float>(n_samples_30s, 0.0f);
-    ctx->pcmf32_new = std::vector<float>(n_samples_30s, 0.0f);
+    ctx->queue = std::make_unique<window_queue>(params.queue_depth, params.overflow_policy, n_samples_30s);
 
-    ctx->t_last = std::chrono::high_resolution_clock::now();
-    ctx->t_start = ctx->t_last;
+    // a 30 s arena only needs to move the window back to its start every few steps
+    {
+        const int n_samples_len_max  = ctx->controller ? std::max<int>(ctx->n_samples_len, (1e-3 * params.length_ms_max) * WHISPER_SAMPLE_RATE) : ctx->n_samples_len.load();
+        const int n_samples_step_max = ctx->controller ? std::max<int>(ctx->n_samples_step, (1e-3 * params.step_ms_max) * WHISPER_SAMPLE_RATE) : ctx->n_samples_step.load();
+
+        ctx->samples = audio_window(std::max(n_samples_30s, 2*(ctx->n_samples_keep + n_samples_len_max + 2*n_samples_step_max)));
+    }
+
+    if (ctx->use_vad || params.vad_gate) {
+        vad_stream_params vparams;
+        vparams.sample_rate = WHISPER_SAMPLE_RATE;
+        vparams.vad_thold   = params.vad_thold;
+        vparams.freq_thold  = params.freq_thold;
+
+        ctx->vad = vad_stream(vparams);
+        ctx->n_samples_vad_block = (1e-3 * 100) * WHISPER_SAMPLE_RATE;
+        ctx->n_samples_vad_last = (1e-3 * vparams.last_ms) * WHISPER_SAMPLE_RATE;
+    }
 
     ctx->params = params;
 
+    // streams of several speakers get consecutive runs of cores, a final model the run after its stream's
+    const int n_slots = params.final_model != NULL ? 2 : 1;
+
+    if (params.placement == STREAM_PLACEMENT_CORES) {
+        ctx->placement = cpu_place(cpu_topology::system(), params.n_threads, n_slots*params.speaker);
+        ctx->audio->set_capture_cpus(ctx->placement.capture);
+    }
+
+    if (params.final_model != NULL) {
+        final_decoder_params fparams;
+        fparams.n_threads = params.final_n_threads > 0 ? params.final_n_threads : params.n_threads;
+        fparams.language  = params.language;
+        fparams.translate = params.translate;
+
+        if (params.placement == STREAM_PLACEMENT_CORES) {
+            fparams.cpus = cpu_place(cpu_topology::system(), fparams.n_threads, n_slots*params.speaker + 1).decode;
+        }
+
+        ctx->finals = std::make_unique<final_decoder>();
+        if (!ctx->finals->init(params.final_model, fparams, ctx->audio->ring())) {
+            fprintf(stderr, "%s: failed to load the final model '%s'\n", __func__, params.final_model);
+            return NULL;
+        }
+    }
+
+    if (params.lock_memory && !whisper_model_lock_memory()) {
+        fprintf(stderr, "%s: WARNING: failed to lock the model into memory\n", __func__);
+    }
+
+    // the cursor and the recorder first, a replayed source starts delivering right away
+    ctx->cursor = ctx->audio->cursor();
+    ctx->pos_window = ctx->cursor.pos;
+    if (params.record != NULL) {
+        ctx->recorder = std::make_unique<session_recorder>();
+        if (!ctx->recorder->open(params.record, ctx->audio->ring(), ctx->audio->sample_rate())) {
+            return NULL;
+        }
+    }
+    if (ctx->finals) {
+        // a replay as fast as possible waits for the final model instead of lapping it
+        ctx->audio->hold(ctx->cursor.pos);
+    }
+    ctx->audio->resume();
+    ctx->pos_start = ctx->cursor.pos;
+    ctx->pos_commit = ctx->pos_start;
+    ctx->pos_final = ctx->pos_start;
+    ctx->pos_tentative = ctx->pos_start;
+
+    if (params.incremental) {
+        ctx->agreement.emplace(ctx->pos_start);
+    }
+
+    // assemble windows on a separate thread, so capture keeps being consumed while whisper runs
+    ctx->assembler = std::jthread([ctx = ctx.get()](std::stop_token stoken) {
+        // next to the capture, off the decoder's cores
+        cpu_pin_thread(ctx->placement.capture);
+
+        while (!stoken.stop_requested() && !ctx->drained) {
+            if (ctx->use_vad) {
+                stream_assemble_vad(ctx);
+            } else {
+                stream_assemble_step(ctx);
+            }
+        }
+    });
+
+    // audio captured meanwhile is queued and decoded right after
+    if (params.warmup) {
+        stream_warmup(ctx.get());
+    }
+
     return ctx.release();
 }
 
 void stream_free(stream_context *ctx) {
-    ctx->audio = NULL;
-    ctx->whisper = NULL;
-    ctx->pcmf32.clear();
-    ctx->pcmf32_old.clear();
-    ctx->pcmf32_new.clear();
-    ctx->prompt_tokens.clear();
+    ctx->assembler.request_stop();
+    ctx->assembler.join();
+
+    delete ctx;
+
+    // forget the models no other stream uses
+    whisper_model_cache_trim();
 }
 
-int stream_run(stream_context *ctx, void *callback_ctx, stream_callback_t callback) {
+void stream_get_stats(stream_context *ctx, stream_stats_t *stats) {
+    *stats = stream_stats_t {};
+
+    ctx->queue->get_stats(*stats);
+    stats->n_samples_lost = ctx->n_samples_lost;
+    stats->warmup_ms = ctx->warmup_ms;
+    stats->rtf = ctx->rtf;
+    stats->step_ms = (1000.0 * ctx->n_samples_step) / WHISPER_SAMPLE_RATE;
+    stats->length_ms = (1000.0 * ctx->n_samples_len) / WHISPER_SAMPLE_RATE;
+    stats->n_retried = ctx->n_retried;
+    stats->last_decode_ms = ctx->last_decode_ms;
+    stats->n_gated = ctx->n_gated;
+    stats->final_pending = ctx->finals ? ctx->finals->n_pending() : 0;
+}
+
+// ms since the start of the stream
+static int64_t stream_time_ms(const stream_context *ctx, uint64_t pos) {
+    return ((pos - ctx->pos_start) * 1000) / WHISPER_SAMPLE_RATE;
+}
+
+// decode the next window into ctx->current and ctx->state, decoded is false if none arrived in time
+static int stream_decode(stream_context *ctx, bool & decoded) {
     auto params = ctx->params;
     auto whisper = ctx->whisper.get();
+    auto state = ctx->state.get();
+
+    decoded = false;
+
+    if (!ctx->queue->pop(ctx->current, STREAM_WAIT_TIMEOUT_MS)) {
+        // nothing to decode yet, give the caller a chance to stop the stream
+        if (!ctx->drained) {
+            return 0;
+        }
+
+        // the last window may have been queued while we waited
+        if (!ctx->queue->pop(ctx->current, 0)) {
+            return STREAM_RUN_END;
+        }
+    }
+
+    auto & window = ctx->current;
 
-    auto t_now = std::chrono::high_resolution_clock::now();
+    // the audio is still in the capture ring, only what the previous window did not have is copied
+    const uint64_t begin = ctx->samples.slide(ctx->audio->ring(), window.begin, window.end);
+    if (begin != window.begin) {
+        fprintf(stderr, "%s: WARNING: %d ms of the window were overwritten before it was decoded\n", __func__,
+                (int) ((1000 * (std::min(begin, window.end) - window.begin)) / WHISPER_SAMPLE_RATE));
+        window.begin = std::min(begin, window.end);
+    }
+
+    if (ctx->samples.empty()) {
+        return 0;
+    }
+
+    stream_place_decoder(ctx);
+
+    // run the inference
+    whisper_full_params wparams = stream_whisper_params(ctx);
+
+    if (window.degraded || params.audio_ctx == STREAM_AUDIO_CTX_AUTO) {
+        // only encode as much context as the window needs, instead of padding it to 30 s
+        wparams.audio_ctx = stream_audio_ctx(ctx->samples.size());
+    }
 
-    if (!ctx->use_vad) {
-        while (true) {
-            ctx->audio->get(params.step_ms, ctx->pcmf32_new);
+    if (ctx->agreement) {
+        // the audio of the committed text is gone, so it is always the prompt
+        ctx->agreement->prompt(ctx->prompt_tokens, STREAM_PROMPT_MAX_TOKENS);
 
-            if ((int)ctx->pcmf32_new.size() > 2 * ctx->n_samples_step) {
-                fprintf(stderr, "\n\n%s: WARNING: cannot process audio fast enough, dropping audio ...\n\n", __func__);
-                ctx->audio->clear();
+        wparams.token_timestamps = true;
+        wparams.prompt_tokens = ctx->prompt_tokens.data();
+        wparams.prompt_n_tokens = ctx->prompt_tokens.size();
+    } else {
+        wparams.prompt_tokens = params.no_context ? nullptr : ctx->prompt_tokens.data();
+        wparams.prompt_n_tokens = params.no_context ? 0 : ctx->prompt_tokens.size();
+    }
+
+    const auto t_decode = std::chrono::high_resolution_clock::now();
+
+    if (whisper_full_with_state(whisper, state, wparams, ctx->samples.data(), ctx->samples.size()) != 0) {
+        fprintf(stderr, "%s: failed to process audio\n", __func__);
+        return 6;
+    }
+
+    // quality guard: a poor decode with a reduced context is repeated with the full one,
+    // unless the decoder is behind and has to make do with it
+    if (params.audio_ctx == STREAM_AUDIO_CTX_AUTO && !window.degraded && wparams.audio_ctx < 1500 &&
+        stream_avg_logprob(whisper, state) < STREAM_AUDIO_CTX_LOGPROB_THOLD) {
+        wparams.audio_ctx = 0;
+        ++ctx->n_retried;
+
+        if (whisper_full_with_state(whisper, state, wparams, ctx->samples.data(), ctx->samples.size()) != 0) {
+            fprintf(stderr, "%s: failed to process audio\n", __func__);
+            return 6;
+        }
+    }
+
+    const double decode_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t_decode).count();
+    const double audio_ms = (1000.0 * window.size()) / WHISPER_SAMPLE_RATE;
+
+    ctx->last_decode_ms = decode_ms;
+
+    ctx->rtf = ctx->rtf == 0.0f ? decode_ms / audio_ms : ctx->rtf + 0.2f * (decode_ms / audio_ms - ctx->rtf);
+
+    if (ctx->controller) {
+        // retune the next steps to what this machine can keep up with
+        ctx->controller->update(decode_ms, audio_ms);
+
+        ctx->n_samples_step = (1e-3 * ctx->controller->step_ms()) * WHISPER_SAMPLE_RATE;
+        ctx->n_samples_len = (1e-3 * ctx->controller->length_ms()) * WHISPER_SAMPLE_RATE;
+        ctx->rtf = ctx->controller->rtf();
+    }
+
+    decoded = true;
+
+    return 0;
+}
+
+// incremental mode: commit what this decode agrees on with the previous one into ctx->committed
+// returns true if nothing was said, neither in this window nor tentatively before
+static bool stream_agree(stream_context *ctx) {
+    auto whisper = ctx->whisper.get();
+    auto state = ctx->state.get();
+
+    const auto & window = ctx->current;
+    const whisper_token token_eot = whisper_token_eot(whisper);
+
+    ctx->tokens.clear();
+    ctx->committed.clear();
+
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; ++i) {
+        const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            const whisper_token_data data = whisper_full_get_token_data_from_state(state, i, j);
+
+            // timestamps and other special tokens are not text
+            if (data.id >= token_eot) {
                 continue;
             }
 
-            if ((int)ctx->pcmf32_new.size() >= ctx->n_samples_step) {
-                ctx->audio->clear();
-                break;
+            ctx->tokens.push_back(hypothesis_token_from_whisper(data.id, whisper_full_get_token_text_from_state(whisper, state, i, j), window.begin, data.t0, data.t1));
+        }
+    }
+
+    const bool silent = ctx->tokens.empty() && ctx->agreement->tentative().empty();
+
+    ctx->agreement->update(std::move(ctx->tokens), window.new_line, ctx->committed);
+
+    if (window.new_line) {
+        // the assembler only kept params.keep_ms of this window
+        ctx->agreement->advance(window.end - std::min<uint64_t>(window.size(), ctx->n_samples_keep));
+    } else if (silent) {
+        // nothing said so far, only the last step can hold the start of a word
+        ctx->agreement->advance(window.end - std::min<uint64_t>(window.size(), ctx->n_samples_step));
+    }
+
+    ctx->pos_commit = ctx->agreement->pos_commit();
+
+    return silent;
+}
+
+// incremental mode: the committed text as a final segment, the tentative text as the partial one
+static void stream_emit_agreed(stream_context *ctx, void *callback_ctx, stream_segment_callback_t callback) {
+    stream_agree(ctx);
+
+    if (!ctx->committed.empty()) {
+        ctx->text.clear();
+        for (const auto & token : ctx->committed) {
+            ctx->text += token.text;
+        }
+
+        const stream_segment_t segment = {
+            STREAM_SEGMENT_FINAL, ctx->text.c_str(), stream_time_ms(ctx, ctx->committed.front().t0), stream_time_ms(ctx, ctx->committed.back().t1), ctx->params.speaker, ctx->params.model,
+        };
+        callback(&segment, callback_ctx);
+    }
+
+    const auto & tentative = ctx->agreement->tentative();
+
+    ctx->text.clear();
+    for (const auto & token : tentative) {
+        ctx->text += token.text;
+    }
+
+    const uint64_t pos_t0 = tentative.empty() ? ctx->pos_commit.load() : tentative.front().t0;
+    const uint64_t pos_t1 = tentative.empty() ? ctx->pos_commit.load() : tentative.back().t1;
+
+    const stream_segment_t segment = {
+        STREAM_SEGMENT_PARTIAL, ctx->text.c_str(), stream_time_ms(ctx, pos_t0), stream_time_ms(ctx, pos_t1), ctx->params.speaker, ctx->params.model,
+    };
+    callback(&segment, callback_ctx);
+}
+
+// the decoder is done with ctx->current
+static void stream_finish(stream_context *ctx) {
+    auto state = ctx->state.get();
+
+    // Add tokens of the last full length segment as the prompt
+    if (!ctx->agreement && !ctx->use_vad && ctx->current.new_line && !ctx->params.no_context) {
+        ctx->prompt_tokens.clear();
+
+        const int n_segments = whisper_full_n_segments_from_state(state);
+        for (int i = 0; i < n_segments; ++i) {
+            const int token_count = whisper_full_n_tokens_from_state(state, i);
+            for (int j = 0; j < token_count; ++j) {
+                ctx->prompt_tokens.push_back(whisper_full_get_token_id_from_state(state, i, j));
             }
+        }
+    }
+}
+
+// cascade: hand the audio of an utterance to the final model, along with the fast model's text for it
+static void stream_cascade_push(stream_context *ctx, uint64_t begin, uint64_t end, std::string draft) {
+    begin = std::max(begin, ctx->pos_final);
+    if (end <= begin) {
+        return;
+    }
+
+    ctx->pos_final = end;
+
+    // nothing to improve on where the fast model heard nothing
+    if (draft.empty()) {
+        return;
+    }
+
+    final_job job = { begin, end, std::move(draft) };
+
+    ctx->drafts.push_back(job);
+    ctx->finals->push(std::move(job));
+}
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+// cascade: commit the decoded window, in utterances for the final model and tentative text
+static void stream_cascade_commit(stream_context *ctx) {
+    const auto & window = ctx->current;
+
+    if (ctx->agreement) {
+        const bool silent = stream_agree(ctx);
+
+        for (const auto & token : ctx->committed) {
+            ctx->utterance += token.text;
         }
 
-        const int n_samples_new = ctx->pcmf32_new.size();
+        const auto & tentative = ctx->agreement->tentative();
 
-        // take up to params.length_ms audio from previous iteration
-        const int n_samples_take = std::min((int)ctx->pcmf32_old.size(), std::max(0, ctx->n_samples_keep + ctx->n_samples_len - n_samples_new));
+        ctx->tentative.clear();
+        for (const auto & token : tentative) {
+            ctx->tentative += token.text;
+        }
+        ctx->pos_tentative = tentative.empty() ? ctx->pos_commit.load() : tentative.back().t1;
 
-        ctx->pcmf32.resize(n_samples_new + n_samples_take);
+        // an utterance ends with its line, a pause, or once it is long enough to be worth decoding
+        const uint64_t pos_commit = ctx->pos_commit;
+        const uint64_t n_samples_max = (STREAM_CASCADE_UTTERANCE_MS * WHISPER_SAMPLE_RATE) / 1000;
 
-        for (int i = 0; i < n_samples_take; i++) {
-            ctx->pcmf32[i] = ctx->pcmf32_old[ctx->pcmf32_old.size() - n_samples_take + i];
+        if (window.new_line || silent || pos_commit - ctx->pos_final >= n_samples_max) {
+            stream_cascade_push(ctx, ctx->pos_final, pos_commit, std::move(ctx->utterance));
+            ctx->utterance.clear();
         }
 
-        memcpy(ctx->pcmf32.data() + n_samples_take, ctx->pcmf32_new.data(), n_samples_new * sizeof(float));
+        return;
+    }
+
+    auto state = ctx->state.get();
+
+    ctx->text.clear();
 
-        ctx->pcmf32_old = ctx->pcmf32;
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; ++i) {
+        ctx->text += whisper_full_get_segment_text_from_state(state, i);
+    }
+
+    // without agreement, a window is committed once it ends a line
+    if (ctx->use_vad || window.new_line) {
+        stream_cascade_push(ctx, window.begin, window.end, ctx->text);
+        ctx->tentative.clear();
     } else {
-        auto t_diff = std::chrono::duration_cast<std::chrono::milliseconds>(t_now - ctx->t_last).count();
-        if (t_diff < 2000) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            return 0;
-        }
+        ctx->tentative = ctx->text;
+    }
 
-        // process new audio
-        ctx->audio->get(2000, ctx->pcmf32_new);
+    ctx->pos_tentative = window.end;
+}
 
-        if (::vad_simple(ctx->pcmf32_new, WHISPER_SAMPLE_RATE, 1000, params.vad_thold, params.freq_thold, false)) {
-            ctx->audio->get(params.length_ms, ctx->pcmf32);
-        } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            return 0;
+// cascade: the utterances the final model has finished as final segments, then the rest as the partial one
+static void stream_cascade_emit(stream_context *ctx, bool changed, int timeout_ms, void *callback_ctx, stream_segment_callback_t callback) {
+    final_result result;
+
+    while (ctx->finals->pop(result, timeout_ms)) {
+        timeout_ms = 0;
+        changed = true;
+
+        ctx->drafts.pop_front();
+
+        // the draft stands in for an utterance whose audio was gone
+        const char *model = result.refined ? ctx->params.final_model : ctx->params.model;
+
+        for (const auto & final : result.segments) {
+            const stream_segment_t segment = {
+                STREAM_SEGMENT_FINAL, final.text.c_str(), stream_time_ms(ctx, final.begin), stream_time_ms(ctx, final.end), ctx->params.speaker, model,
+            };
+            callback(&segment, callback_ctx);
         }
+    }
 
-        ctx->t_last = t_now;
+    if (!changed) {
+        return;
     }
 
-    // run the inference
-    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    ctx->audio->hold(std::min(ctx->finals->pos_oldest(), ctx->pos_final));
 
-    wparams.print_progress = false;
-    wparams.print_special = params.print_special;
-    wparams.print_realtime = false;
-    wparams.print_timestamps = !params.no_timestamps;
-    wparams.translate = params.translate;
-    wparams.no_context = true;
-    wparams.single_segment = !ctx->use_vad;
-    wparams.max_tokens = params.max_tokens;
-    wparams.language = params.language;
-    wparams.n_threads = params.n_threads;
+    ctx->text.clear();
+    for (const auto & draft : ctx->drafts) {
+        ctx->text += draft.draft;
+    }
+    ctx->text += ctx->utterance;
+    ctx->text += ctx->tentative;
 
-    wparams.audio_ctx = params.audio_ctx;
-    //wparams.speed_up = params.speed_up; // this is no longer a parameter
+    const uint64_t pos_t0 = ctx->drafts.empty() ? ctx->pos_final : ctx->drafts.front().begin;
+    const uint64_t pos_t1 = std::max(pos_t0, ctx->pos_tentative);
 
-    // disable temperature fallback
-    wparams.temperature_inc = -1.0f;
+    const stream_segment_t segment = {
+        STREAM_SEGMENT_PARTIAL, ctx->text.c_str(), stream_time_ms(ctx, pos_t0), stream_time_ms(ctx, pos_t1), ctx->params.speaker, ctx->params.model,
+    };
+    callback(&segment, callback_ctx);
+}
+
+// cascade: stream_run_segments once the fast model has decoded, or not
+static int stream_run_cascade(stream_context *ctx, int ret, bool decoded, void *callback_ctx, stream_segment_callback_t callback) {
+    if (ret != 0 && ret != STREAM_RUN_END) {
+        return ret;
+    }
 
-    wparams.prompt_tokens = params.no_context ? nullptr : ctx->prompt_tokens.data();
-    wparams.prompt_n_tokens = params.no_context ? 0 : ctx->prompt_tokens.size();
+    bool changed = decoded;
 
-    const int64_t t1 = (t_now - ctx->t_start).count() / 1000000;
-    const int64_t t0 = std::max(0.0, t1 - ctx->pcmf32.size() * 1000.0 / WHISPER_SAMPLE_RATE);
+    if (decoded) {
+        stream_cascade_commit(ctx);
+        stream_finish(ctx);
+    }
 
-    if (whisper_full(whisper, wparams, ctx->pcmf32.data(), ctx->pcmf32.size()) != 0) {
-        fprintf(stderr, "%s: failed to process audio\n", __func__);
-        return 6;
+    // at the end of a replay everything is committed, the tentative text too
+    const bool end = ret == STREAM_RUN_END;
+    if (end && (!ctx->utterance.empty() || !ctx->tentative.empty())) {
+        stream_cascade_push(ctx, ctx->pos_final, std::max(ctx->pos_commit.load(), ctx->pos_tentative), ctx->utterance + ctx->tentative);
+
+        ctx->utterance.clear();
+        ctx->tentative.clear();
+        changed = true;
     }
 
-    const int n_segments = whisper_full_n_segments(whisper);
+    stream_cascade_emit(ctx, changed, end ? STREAM_WAIT_TIMEOUT_MS : 0, callback_ctx, callback);
+
+    // the stream only ends once the final model has caught up
+    if (end && ctx->finals->n_pending() > 0) {
+        return 0;
+    }
+
+    return ret;
+}
+
+int stream_run(stream_context *ctx, void *callback_ctx, stream_callback_t callback) {
+    if (ctx->agreement || ctx->finals) {
+        // final segments end the line, partial ones overwrite it
+        struct adapter_t {
+            stream_callback_t callback;
+            void *callback_ctx;
+        } adapter = { callback, callback_ctx };
+
+        return stream_run_segments(ctx, &adapter, +[](const stream_segment_t *segment, void *data) -> int {
+            auto adapter = static_cast<adapter_t *>(data);
+
+            adapter->callback(segment->text, segment->t0, segment->t1, adapter->callback_ctx);
+            if (segment->kind == STREAM_SEGMENT_FINAL) {
+                adapter->callback(NULL, 0, 0, adapter->callback_ctx);
+            }
+
+            return 0;
+        });
+    }
+
+    bool decoded = false;
+    if (const int ret = stream_decode(ctx, decoded); ret != 0 || !decoded) {
+        return ret;
+    }
+
+    auto state = ctx->state.get();
+    const auto & window = ctx->current;
+
+    // timestamps in ms, derived from the capture position of the window
+    const int64_t t0 = stream_time_ms(ctx, window.begin);
+    const int64_t t1 = stream_time_ms(ctx, window.end);
+
+    const int n_segments = whisper_full_n_segments_from_state(state);
     for (int i = 0; i < n_segments; ++i) {
-        const char *text = whisper_full_get_segment_text(whisper, i);
+        const char *text = whisper_full_get_segment_text_from_state(state, i);
 
-        const int64_t segment_t0 = whisper_full_get_segment_t0(whisper, i);
-        const int64_t segment_t1 = whisper_full_get_segment_t1(whisper, i);
+        // segment timestamps are in units of 10 ms relative to the window
+        const int64_t segment_t0 = t0 + whisper_full_get_segment_t0_from_state(state, i) * 10;
+        const int64_t segment_t1 = t0 + whisper_full_get_segment_t1_from_state(state, i) * 10;
 
         callback(text, ctx->use_vad ? segment_t0 : t0, ctx->use_vad ? segment_t1 : t1, callback_ctx);
     }
 
-    ++ctx->n_iter;
-
-    if (!ctx->use_vad && (ctx->n_iter % ctx->n_new_line) == 0) {
+    if (!ctx->use_vad && window.new_line) {
         callback(NULL, 0, 0, callback_ctx);
+    }
 
-        // keep part of the audio for next iteration to try to mitigate word boundary issues
-        ctx->pcmf32_old = std::vector<float>(ctx->pcmf32.end() - ctx->n_samples_keep, ctx->pcmf32.end());
-
-        // Add tokens of the last full length segment as the prompt
-        if (!params.no_context) {
-            ctx->prompt_tokens.clear();
-
-            const int n_segments = whisper_full_n_segments(whisper);
-            for (int i = 0; i < n_segments; ++i) {
-                const int token_count = whisper_full_n_tokens(whisper, i);
-                for (int j = 0; j < token_count; ++j) {
-                    ctx->prompt_tokens.push_back(whisper_full_get_token_id(whisper, i, j));
-                }
-            }
-        }
+    stream_finish(ctx);
+
+    return 0;
+}
+
+int stream_run_segments(stream_context *ctx, void *callback_ctx, stream_segment_callback_t callback) {
+    bool decoded = false;
+    const int ret = stream_decode(ctx, decoded);
+
+    if (ctx->finals) {
+        return stream_run_cascade(ctx, ret, decoded, callback_ctx, callback);
+    }
+
+    if (ret != 0 || !decoded) {
+        return ret;
+    }
+
+    if (ctx->agreement) {
+        stream_emit_agreed(ctx, callback_ctx, callback);
+        stream_finish(ctx);
+        return 0;
     }
 
+    auto state = ctx->state.get();
+    const auto & window = ctx->current;
+
+    // without agreement, a window is final once it ends a line
+    const stream_segment_kind_t kind = ctx->use_vad || window.new_line ? STREAM_SEGMENT_FINAL : STREAM_SEGMENT_PARTIAL;
+
+    const int64_t t0 = stream_time_ms(ctx, window.begin);
+    const int64_t t1 = stream_time_ms(ctx, window.end);
+
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; ++i) {
+        const int64_t segment_t0 = t0 + whisper_full_get_segment_t0_from_state(state, i) * 10;
+        const int64_t segment_t1 = t0 + whisper_full_get_segment_t1_from_state(state, i) * 10;
+
+        const stream_segment_t segment = {
+            kind, whisper_full_get_segment_text_from_state(state, i), ctx->use_vad ? segment_t0 : t0, ctx->use_vad ? segment_t1 : t1, ctx->params.speaker, ctx->params.model,
+        };
+        callback(&segment, callback_ctx);
+    }
+
+    if (n_segments == 0 && kind == STREAM_SEGMENT_FINAL && !ctx->use_vad) {
+        // close the line even if its last window was silent
+        const stream_segment_t segment = { STREAM_SEGMENT_FINAL, "", t0, t1, ctx->params.speaker, ctx->params.model };
+        callback(&segment, callback_ctx);
+    }
+
+    stream_finish(ctx);
+
     return 0;
 }
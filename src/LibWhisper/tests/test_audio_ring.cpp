@@ -0,0 +1,189 @@
+// Checks the capture ring: reads, lapping, oversized writes, and that n_overwritten()
+// reports every sample a copy may have torn, also while the producer is writing.
+
+#include <audio_ring.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+// every sample holds its own position, as far as a float holds it exactly
+static float sample_at(uint64_t pos) {
+    return (float) (pos % (1 << 24));
+}
+
+static void write_from(audio_ring & ring, uint64_t pos, size_t n) {
+    std::vector<float> data(n);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = sample_at(pos + i);
+    }
+
+    ring.write(data.data(), n);
+}
+
+// the samples of v from offset on hold their positions
+static bool holds_positions(const audio_ring::view & v, size_t offset = 0) {
+    std::vector<float> data(v.size());
+    v.copy(data.data());
+
+    for (size_t i = offset; i < data.size(); i++) {
+        if (data[i] != sample_at(v.begin + i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void test_read() {
+    audio_ring ring(100);
+    CHECK(ring.capacity() == 128, "capacity %zu instead of 128", ring.capacity());
+
+    auto cursor = ring.make_cursor();
+
+    write_from(ring, 0, 50);
+    auto v = ring.read(cursor, 20);
+    CHECK(v.begin == 0 && v.size() == 20 && holds_positions(v), "partial read");
+
+    ring.consume(cursor, v.size());
+    v = ring.read(cursor);
+    CHECK(v.begin == 20 && v.size() == 30 && holds_positions(v), "rest of the block");
+
+    // wraps around the end of the buffer
+    ring.consume(cursor, v.size());
+    write_from(ring, 50, 100);
+    v = ring.read(cursor);
+    CHECK(v.begin == 50 && v.size() == 100 && !v.second.empty() && holds_positions(v), "read across the wrap");
+    CHECK(cursor.n_lost == 0 && ring.intact(v), "nothing lost yet");
+}
+
+static void test_lapping() {
+    audio_ring ring(64);
+
+    auto cursor = ring.make_cursor();
+
+    write_from(ring, 0, 40);
+    const auto held = ring.range(10, 40);
+    CHECK(held.size() == 30 && ring.intact(held), "range still resident");
+
+    // 100 more samples lap the reader: only the newest 64 are left
+    write_from(ring, 40, 100);
+
+    auto v = ring.read(cursor);
+    CHECK(cursor.n_lost == 140 - 64, "%llu lost instead of %d", (unsigned long long) cursor.n_lost, 140 - 64);
+    CHECK(v.begin == 140 - 64 && v.size() == 64 && holds_positions(v), "lapped read starts at the oldest sample");
+
+    // the held view covered 10..40, everything up to 76 was overwritten
+    CHECK(ring.n_overwritten(held) == held.size(), "%zu of %zu overwritten", ring.n_overwritten(held), held.size());
+    CHECK(!ring.intact(held), "lapped view is not intact");
+
+    // range() clamps to what is resident
+    auto tail = ring.range(70, 100);
+    CHECK(tail.begin == 76 && tail.size() == 24, "range clamped to %llu instead of 76", (unsigned long long) tail.begin);
+
+    // 20 more samples: the oldest resident one is now 96, the first 20 samples of tail are gone
+    write_from(ring, 140, 20);
+    CHECK(ring.n_overwritten(tail) == 20, "%zu of the view overwritten instead of 20", ring.n_overwritten(tail));
+    CHECK(holds_positions(tail, 20), "the rest of the view is sound");
+
+    // range() of a span that is gone completely comes back empty
+    auto gone = ring.range(0, 50);
+    CHECK(gone.empty(), "%zu samples of a range that is gone", gone.size());
+}
+
+static void test_oversized_write() {
+    audio_ring ring(64);
+
+    auto cursor = ring.make_cursor();
+
+    // more than the ring holds in one write: the samples that did not fit still count
+    write_from(ring, 0, 200);
+    CHECK(ring.head() == 200, "head %llu instead of 200", (unsigned long long) ring.head());
+
+    auto v = ring.read(cursor);
+    CHECK(cursor.n_lost == 200 - 64, "%llu lost instead of %d", (unsigned long long) cursor.n_lost, 200 - 64);
+    CHECK(v.begin == 200 - 64 && v.size() == 64, "newest samples resident");
+    CHECK(holds_positions(v), "the newest samples are at their positions");
+    CHECK(ring.intact(v), "the resident samples are intact");
+
+    auto latest = ring.latest(10);
+    CHECK(latest.begin == 190 && holds_positions(latest), "latest after an oversized write");
+}
+
+// the producer laps a reader that copies slowly: whatever n_overwritten() does not
+// report has to be what the producer wrote there, even while a write is under way
+static void test_concurrent() {
+    audio_ring ring(1024);
+
+    std::atomic<bool> done = false;
+
+    // long blocks keep the producer inside a write for most of the time
+    std::thread producer([&]() {
+        std::vector<float> data(509);
+        uint64_t pos = 0;
+
+        while (!done) {
+            for (size_t i = 0; i < data.size(); i++) {
+                data[i] = sample_at(pos + i);
+            }
+
+            ring.write(data.data(), data.size());
+            pos += data.size();
+        }
+    });
+
+    // from when the ring is full
+    while (ring.head() < ring.capacity()) {
+        std::this_thread::yield();
+    }
+
+    size_t n_torn = 0;
+
+    for (int i = 0; i < 200000 && n_failed == 0; i++) {
+        // the oldest samples, the next write overwrites them
+        const uint64_t head = ring.head();
+        const auto v = ring.range(head - std::min<uint64_t>(head, ring.capacity()), head);
+
+        std::vector<float> data(v.size());
+        v.copy(data.data());
+
+        const size_t n_overwritten = ring.n_overwritten(v);
+        n_torn += n_overwritten > 0;
+
+        for (size_t j = n_overwritten; j < data.size(); j++) {
+            if (data[j] != sample_at(v.begin + j)) {
+                CHECK(false, "sample %llu torn but not reported, %zu of %zu overwritten", (unsigned long long) (v.begin + j), n_overwritten, v.size());
+                break;
+            }
+        }
+    }
+
+    done = true;
+    producer.join();
+
+    fprintf(stderr, "%s: %zu copies overlapped a write\n", __func__, n_torn);
+}
+
+int main() {
+    test_read();
+    test_lapping();
+    test_oversized_write();
+    test_concurrent();
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
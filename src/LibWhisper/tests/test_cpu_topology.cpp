@@ -0,0 +1,170 @@
+// Checks the CPU topology against sysfs trees written for the purpose, and the
+// placement of the threads on them. Reading sysfs is only supported on Linux.
+
+#include <cpu_topology.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+#ifdef __linux__
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path & path, const std::string & line) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path) << line << "\n";
+}
+
+// a fake sysfs CPU tree: the CPUs as (siblings, capacity) pairs, all of them online
+struct fake_cpu {
+    std::string siblings;
+    int capacity;
+};
+
+static std::string write_sysfs(const fs::path & root, const std::vector<fake_cpu> & cpus, const std::string & atom = "") {
+    fs::remove_all(root);
+
+    const fs::path sysfs = root / "devices/system/cpu";
+
+    write_file(sysfs / "online", "0-" + std::to_string(cpus.size() - 1));
+
+    for (size_t i = 0; i < cpus.size(); i++) {
+        const fs::path dir = sysfs / ("cpu" + std::to_string(i));
+
+        write_file(dir / "topology/thread_siblings_list", cpus[i].siblings);
+        write_file(dir / "topology/physical_package_id", "0");
+        write_file(dir / "cpu_capacity", std::to_string(cpus[i].capacity));
+    }
+
+    if (!atom.empty()) {
+        write_file(root / "devices/cpu_atom/cpus", atom);
+    }
+
+    return sysfs.string();
+}
+
+static std::string cpus_str(const std::vector<int> & cpus) {
+    std::string s;
+    for (int cpu : cpus) {
+        s += (s.empty() ? "" : ",") + std::to_string(cpu);
+    }
+
+    return s;
+}
+
+// two P cores with two threads each, four E cores
+static void test_hybrid(const fs::path & root) {
+    const std::string sysfs = write_sysfs(root, {
+        { "0-1", 1024 }, { "0-1", 1024 }, { "2-3", 1024 }, { "2-3", 1024 },
+        { "4", 400 }, { "5", 400 }, { "6", 400 }, { "7", 400 },
+    });
+
+    cpu_topology topology;
+    CHECK(topology.load(sysfs), "failed to load the hybrid tree");
+
+    const auto & cores = topology.cores();
+    CHECK(cores.size() == 6, "%zu cores instead of 6", cores.size());
+    if (cores.size() != 6) {
+        return;
+    }
+
+    CHECK(cpus_str(cores[0].cpus) == "0,1" && cpus_str(cores[1].cpus) == "2,3", "P cores %s and %s", cpus_str(cores[0].cpus).c_str(), cpus_str(cores[1].cpus).c_str());
+    CHECK(!cores[0].efficient && !cores[1].efficient && cores[2].efficient && cores[5].efficient, "E cores not told apart");
+
+    // two decoders on the P cores, capture on the slowest core
+    auto placement = cpu_place(topology, 2);
+    CHECK(cpus_str(placement.decode) == "0,2", "decode on %s", cpus_str(placement.decode).c_str());
+    CHECK(cpus_str(placement.capture) == "7", "capture on %s", cpus_str(placement.capture).c_str());
+
+    // the next stream gets the next cores
+    placement = cpu_place(topology, 2, 1);
+    CHECK(cpus_str(placement.decode) == "4,5", "second slot decodes on %s", cpus_str(placement.decode).c_str());
+
+    // a decoder that needs every core gets all of them, capture is left to the scheduler
+    placement = cpu_place(topology, 6);
+    CHECK(cpus_str(placement.decode) == "0,2,4,5,6,7", "decode on %s with every core", cpus_str(placement.decode).c_str());
+    CHECK(placement.capture.empty(), "capture reserved on %s although the decoder needs it", cpus_str(placement.capture).c_str());
+
+    // more threads than cores: the siblings too
+    placement = cpu_place(topology, 12);
+    CHECK(cpus_str(placement.decode) == "0,1,2,3,4,5,6,7", "decode on %s with more threads than cores", cpus_str(placement.decode).c_str());
+    CHECK(placement.capture.empty(), "capture reserved with more threads than cores");
+}
+
+// four SMT cores of the same speed, then E cores only the cpu_atom PMU of an Intel hybrid CPU tells apart
+static void test_smt(const fs::path & root) {
+    const std::string sysfs = write_sysfs(root, {
+        { "0,4", 0 }, { "1,5", 0 }, { "2,6", 0 }, { "3,7", 0 },
+        { "0,4", 0 }, { "1,5", 0 }, { "2,6", 0 }, { "3,7", 0 },
+    });
+
+    cpu_topology topology;
+    CHECK(topology.load(sysfs), "failed to load the SMT tree");
+    CHECK(topology.cores().size() == 4, "%zu cores instead of 4", topology.cores().size());
+
+    // four threads on four cores: one thread per core, nothing reserved for capture
+    const auto placement = cpu_place(topology, 4);
+    CHECK(cpus_str(placement.decode) == "0,1,2,3", "decode on %s", cpus_str(placement.decode).c_str());
+    CHECK(placement.capture.empty(), "capture reserved on %s", cpus_str(placement.capture).c_str());
+
+    const std::string hybrid = write_sysfs(root, {
+        { "0", 0 }, { "1", 0 }, { "2", 0 }, { "3", 0 },
+    }, "2-3");
+
+    cpu_topology atom;
+    CHECK(atom.load(hybrid), "failed to load the cpu_atom tree");
+    CHECK(atom.cores().size() == 4 && !atom.cores()[1].efficient && atom.cores()[2].efficient && atom.cores()[3].efficient, "cpu_atom cores not marked");
+}
+
+static void test_degenerate(const fs::path & root) {
+    cpu_topology missing;
+    CHECK(!missing.load((root / "nothing").string()) && missing.empty(), "loaded a tree that does not exist");
+
+    // a single core: nothing to keep apart
+    cpu_topology single;
+    CHECK(single.load(write_sysfs(root, { { "0-1", 0 }, { "0-1", 0 } })), "failed to load a single core");
+
+    const auto placement = cpu_place(single, 4);
+    CHECK(placement.decode.empty() && placement.capture.empty(), "placed threads on a single core");
+
+    const auto none = cpu_place(missing, 4);
+    CHECK(none.decode.empty() && none.capture.empty(), "placed threads without a topology");
+}
+
+#endif
+
+int main() {
+#ifdef __linux__
+    const fs::path root = fs::temp_directory_path() / ("test_cpu_topology." + std::to_string(::getpid()));
+
+    test_hybrid(root);
+    test_smt(root);
+    test_degenerate(root);
+
+    fs::remove_all(root);
+#else
+    fprintf(stderr, "sysfs is only read on Linux, skipped\n");
+#endif
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// Checks every DSP kernel variant this CPU supports against the scalar reference:
+// the int16 conversions have to match exactly, the float loops within rounding error.
+
+#include <dsp.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// lengths around the vector widths, so both the vector bodies and the scalar tails run
+static const size_t k_sizes[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 1000, 4099 };
+
+// offsets into the buffers, for unaligned loads and stores
+static const size_t k_offsets[] = { 0, 1, 3 };
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+static std::vector<float> random_f32(std::mt19937 & rng, size_t n, float range) {
+    std::uniform_real_distribution<float> dist(-range, range);
+
+    std::vector<float> x(n);
+    for (auto & v : x) {
+        v = dist(rng);
+    }
+
+    return x;
+}
+
+static std::vector<int16_t> random_s16(std::mt19937 & rng, size_t n) {
+    std::uniform_int_distribution<int> dist(INT16_MIN, INT16_MAX);
+
+    std::vector<int16_t> x(n);
+    for (auto & v : x) {
+        v = dist(rng);
+    }
+
+    // the extremes, wherever they fit
+    if (n > 0) { x[0]     = INT16_MIN; }
+    if (n > 1) { x[n - 1] = INT16_MAX; }
+
+    return x;
+}
+
+static void test_s16_to_f32(const dsp_kernels & ref, const dsp_kernels & k, std::mt19937 & rng) {
+    for (size_t n : k_sizes) {
+        for (size_t off : k_offsets) {
+            const auto src = random_s16(rng, n + off);
+
+            std::vector<float> expected(n + off), actual(n + off);
+            ref.s16_to_f32(src.data() + off, expected.data() + off, n);
+            k.s16_to_f32(src.data() + off, actual.data() + off, n);
+
+            CHECK(memcmp(expected.data(), actual.data(), expected.size()*sizeof(float)) == 0, "%s: s16_to_f32, n = %zu, offset = %zu", k.name, n, off);
+
+            // stereo frames, n of them
+            const auto stereo = random_s16(rng, 2*n + off);
+
+            std::vector<float> expected_m(n + off), actual_m(n + off);
+            ref.s16_stereo_to_mono_f32(stereo.data() + off, expected_m.data() + off, n);
+            k.s16_stereo_to_mono_f32(stereo.data() + off, actual_m.data() + off, n);
+
+            CHECK(memcmp(expected_m.data(), actual_m.data(), expected_m.size()*sizeof(float)) == 0, "%s: s16_stereo_to_mono_f32, n = %zu, offset = %zu", k.name, n, off);
+
+            std::vector<float> expected_l(n + off), expected_r(n + off), actual_l(n + off), actual_r(n + off);
+            ref.s16_stereo_to_f32(stereo.data() + off, expected_l.data() + off, expected_r.data() + off, n);
+            k.s16_stereo_to_f32(stereo.data() + off, actual_l.data() + off, actual_r.data() + off, n);
+
+            CHECK(memcmp(expected_l.data(), actual_l.data(), expected_l.size()*sizeof(float)) == 0 &&
+                  memcmp(expected_r.data(), actual_r.data(), expected_r.size()*sizeof(float)) == 0, "%s: s16_stereo_to_f32, n = %zu, offset = %zu", k.name, n, off);
+        }
+    }
+}
+
+static void test_f32_to_s16(const dsp_kernels & ref, const dsp_kernels & k, std::mt19937 & rng) {
+    for (size_t n : k_sizes) {
+        for (size_t off : k_offsets) {
+            // out of range samples are clamped
+            auto src = random_f32(rng, n + off, 1.5f);
+
+            // and the values where truncation and clamping could go wrong
+            const float edges[] = { -1.0f, 1.0f, -0.0f, 0.0f, 1.0f/32767.0f, -1.0f/32767.0f, 0.99999994f, -0.99999994f, 1e-30f, -2.0f, 2.0f };
+            for (size_t i = 0; i < n && i < sizeof(edges)/sizeof(edges[0]); i++) {
+                src[off + i] = edges[i];
+            }
+
+            std::vector<int16_t> expected(n + off), actual(n + off);
+            ref.f32_to_s16(src.data() + off, expected.data() + off, n);
+            k.f32_to_s16(src.data() + off, actual.data() + off, n);
+
+            CHECK(memcmp(expected.data(), actual.data(), expected.size()*sizeof(int16_t)) == 0, "%s: f32_to_s16, n = %zu, offset = %zu", k.name, n, off);
+        }
+    }
+}
+
+static void test_sum_abs(const dsp_kernels & ref, const dsp_kernels & k, std::mt19937 & rng) {
+    for (size_t n : k_sizes) {
+        for (size_t off : k_offsets) {
+            const auto x = random_f32(rng, n + off, 1.0f);
+
+            const float expected = ref.sum_abs(x.data() + off, n);
+            const float actual   = k.sum_abs(x.data() + off, n);
+
+            // every partial sum is at most the total, so each addition is off by at most its ulp
+            const float tol = 2.0f*n*FLT_EPSILON*expected + FLT_MIN;
+
+            CHECK(fabsf(expected - actual) <= tol, "%s: sum_abs, n = %zu, offset = %zu: %g instead of %g", k.name, n, off, actual, expected);
+        }
+    }
+}
+
+static void test_dot(const dsp_kernels & ref, const dsp_kernels & k, std::mt19937 & rng) {
+    for (size_t n : k_sizes) {
+        for (size_t off : k_offsets) {
+            const auto a = random_f32(rng, n + off, 1.0f);
+            const auto b = random_f32(rng, n + off, 1.0f);
+
+            const float expected = ref.dot(a.data() + off, b.data() + off, n);
+            const float actual   = k.dot(a.data() + off, b.data() + off, n);
+
+            // the terms have mixed signs, so the bound is on the sum of their magnitudes
+            float sum_abs = 0.0f;
+            for (size_t i = 0; i < n; i++) {
+                sum_abs += fabsf(a[off + i]*b[off + i]);
+            }
+
+            const float tol = 2.0f*(n + 1)*FLT_EPSILON*sum_abs + FLT_MIN;
+
+            CHECK(fabsf(expected - actual) <= tol, "%s: dot, n = %zu, offset = %zu: %g instead of %g", k.name, n, off, actual, expected);
+        }
+    }
+}
+
+static void test_high_pass(const dsp_kernels & ref, const dsp_kernels & k, std::mt19937 & rng) {
+    const float alphas[] = { 0.5f, 0.9f, 0.99f };
+
+    for (float alpha : alphas) {
+        for (size_t n : k_sizes) {
+            for (size_t off : k_offsets) {
+                const auto x = random_f32(rng, n + off, 1.0f);
+                const float y = 0.25f;
+
+                auto expected = x;
+                auto actual   = x;
+
+                const float y_expected = ref.high_pass(expected.data() + off, n, alpha, y);
+                const float y_actual   = k.high_pass(actual.data() + off, n, alpha, y);
+
+                // y + x - y is x up to the rounding of two additions, the error does not carry over
+                bool ok = fabsf(y_expected - y_actual) <= 4.0f*FLT_EPSILON;
+                for (size_t i = 0; i < n + off; i++) {
+                    ok &= fabsf(expected[i] - actual[i]) <= 4.0f*FLT_EPSILON;
+                }
+
+                CHECK(ok, "%s: high_pass, alpha = %g, n = %zu, offset = %zu", k.name, alpha, n, off);
+            }
+        }
+    }
+}
+
+int main() {
+    const dsp_kernels & ref = dsp_kernels_scalar();
+
+    for (const dsp_kernels * k : dsp_kernels_supported()) {
+        std::mt19937 rng(42);
+
+        test_s16_to_f32(ref, *k, rng);
+        test_f32_to_s16(ref, *k, rng);
+        test_sum_abs(ref, *k, rng);
+        test_dot(ref, *k, rng);
+        test_high_pass(ref, *k, rng);
+
+        fprintf(stderr, "%s: checked\n", k->name);
+    }
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Checks the stable-prefix commit: agreement between decodes, word boundaries,
+// repeats of the committed text, flushes, and tokens whisper has no timestamps for.
+
+#include <local_agreement.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+// samples in whisper's 10 ms timestamp unit
+static const uint64_t k_tick = 160;
+
+// a token of a window starting at ring index 0, times in 10 ms
+static hypothesis_token tok(int32_t id, const char * text, int64_t t0, int64_t t1) {
+    return hypothesis_token_from_whisper(id, text, 0, t0, t1);
+}
+
+static std::string text_of(const std::vector<hypothesis_token> & tokens) {
+    std::string text;
+    for (const auto & token : tokens) {
+        text += token.text;
+    }
+
+    return text;
+}
+
+static void test_agreement() {
+    local_agreement agreement;
+    std::vector<hypothesis_token> committed;
+
+    // nothing to agree with yet
+    agreement.update({ tok(1, " the", 0, 20), tok(2, " cat", 20, 40) }, false, committed);
+    CHECK(committed.empty(), "first decode committed '%s'", text_of(committed).c_str());
+    CHECK(text_of(agreement.tentative()) == " the cat", "tentative '%s'", text_of(agreement.tentative()).c_str());
+
+    // the second decode agrees on " the cat" and revises the rest
+    agreement.update({ tok(1, " the", 0, 20), tok(2, " cat", 20, 40), tok(3, " sat", 40, 60) }, false, committed);
+    CHECK(text_of(committed) == " the cat", "committed '%s'", text_of(committed).c_str());
+    CHECK(text_of(agreement.tentative()) == " sat", "tentative '%s'", text_of(agreement.tentative()).c_str());
+    CHECK(agreement.pos_commit() == 40*k_tick, "commit point %llu", (unsigned long long) agreement.pos_commit());
+
+    // the window still starts at 0: the committed tokens come again and are skipped
+    committed.clear();
+    agreement.update({ tok(1, " the", 0, 20), tok(2, " cat", 20, 40), tok(3, " sat", 40, 60), tok(4, " down", 60, 80) }, false, committed);
+    CHECK(text_of(committed) == " sat", "committed '%s' after the commit point", text_of(committed).c_str());
+
+    std::vector<int32_t> prompt;
+    agreement.prompt(prompt, 2);
+    CHECK(prompt == std::vector<int32_t>({ 2, 3 }), "prompt of %zu tokens", prompt.size());
+}
+
+static void test_word_boundary() {
+    local_agreement agreement;
+    std::vector<hypothesis_token> committed;
+
+    agreement.update({ tok(1, " say", 0, 20), tok(2, " hel", 20, 30), tok(3, "lo", 30, 40) }, false, committed);
+
+    // agrees on " say hel", but "hel" goes on differently: only the whole word is committed
+    agreement.update({ tok(1, " say", 0, 20), tok(2, " hel", 20, 30), tok(4, "p", 30, 40) }, false, committed);
+    CHECK(text_of(committed) == " say", "committed '%s' instead of a whole word", text_of(committed).c_str());
+    CHECK(text_of(agreement.tentative()) == " help", "tentative '%s'", text_of(agreement.tentative()).c_str());
+
+    // no word boundary at all in the agreed prefix
+    local_agreement partial;
+    committed.clear();
+
+    partial.update({ tok(2, " hel", 0, 10), tok(3, "lo", 10, 20) }, false, committed);
+    partial.update({ tok(2, " hel", 0, 10), tok(4, "p", 10, 20) }, false, committed);
+    CHECK(committed.empty(), "committed '%s' of half a word", text_of(committed).c_str());
+}
+
+static void test_repeat() {
+    local_agreement agreement;
+    std::vector<hypothesis_token> committed;
+
+    agreement.update({ tok(1, " the", 0, 20), tok(2, " cat", 20, 40), tok(3, " sat", 40, 60) }, false, committed);
+    agreement.update({ tok(1, " the", 0, 20), tok(2, " cat", 20, 40), tok(3, " sat", 40, 60) }, false, committed);
+    CHECK(text_of(committed) == " the cat sat", "committed '%s'", text_of(committed).c_str());
+
+    // the next window decodes " cat sat" again, with timestamps past the commit point
+    committed.clear();
+    agreement.update({ tok(2, " cat", 61, 70), tok(3, " sat", 70, 80), tok(5, " on", 80, 90) }, false, committed);
+    CHECK(committed.empty(), "committed '%s'", text_of(committed).c_str());
+    CHECK(text_of(agreement.tentative()) == " on", "repeat kept in the tentative tail '%s'", text_of(agreement.tentative()).c_str());
+}
+
+static void test_flush() {
+    local_agreement agreement;
+    std::vector<hypothesis_token> committed;
+
+    agreement.update({ tok(1, " one", 0, 20) }, false, committed);
+
+    // a window that cannot grow any more: all of it, agreed or not, half words too
+    agreement.update({ tok(2, " two", 0, 20), tok(3, " thr", 20, 30), tok(4, "ee", 30, 40) }, true, committed);
+    CHECK(text_of(committed) == " two three", "flushed '%s'", text_of(committed).c_str());
+    CHECK(agreement.tentative().empty(), "tentative after a flush");
+    CHECK(agreement.pos_commit() == 40*k_tick, "commit point %llu after a flush", (unsigned long long) agreement.pos_commit());
+
+    // nothing was said up to 100, the tentative tail goes with the audio
+    agreement.update({ tok(5, " four", 40, 60) }, false, committed);
+    agreement.advance(100*k_tick);
+    CHECK(agreement.tentative().empty() && agreement.pos_commit() == 100*k_tick, "advance");
+
+    // the commit point never goes back
+    agreement.advance(10*k_tick);
+    CHECK(agreement.pos_commit() == 100*k_tick, "advance moved the commit point back");
+}
+
+static void test_no_timestamps() {
+    // whisper reports t0 == t1 == -1 for tokens it has no timestamps for
+    const auto none = hypothesis_token_from_whisper(1, " hi", 1000, -1, -1);
+    CHECK(none.t0 == 1000 && none.t1 == 1000, "no timestamps: %llu-%llu instead of 1000-1000", (unsigned long long) none.t0, (unsigned long long) none.t1);
+
+    const auto no_end = hypothesis_token_from_whisper(1, " hi", 1000, 5, -1);
+    CHECK(no_end.t0 == 1000 + 5*k_tick && no_end.t1 == no_end.t0, "no end: %llu-%llu", (unsigned long long) no_end.t0, (unsigned long long) no_end.t1);
+
+    const auto both = hypothesis_token_from_whisper(1, " hi", 1000, 5, 7);
+    CHECK(both.t0 == 1000 + 5*k_tick && both.t1 == 1000 + 7*k_tick, "timestamps: %llu-%llu", (unsigned long long) both.t0, (unsigned long long) both.t1);
+
+    // such tokens commit without moving the commit point past the window
+    local_agreement agreement(1000);
+    std::vector<hypothesis_token> committed;
+
+    agreement.update({ hypothesis_token_from_whisper(1, " hi", 1000, -1, -1), hypothesis_token_from_whisper(2, " there", 1000, -1, -1) }, false, committed);
+    agreement.update({ hypothesis_token_from_whisper(1, " hi", 1000, -1, -1), hypothesis_token_from_whisper(2, " there", 1000, -1, -1) }, false, committed);
+    CHECK(text_of(committed) == " hi there", "committed '%s'", text_of(committed).c_str());
+    CHECK(agreement.pos_commit() == 1000, "commit point %llu instead of 1000", (unsigned long long) agreement.pos_commit());
+}
+
+int main() {
+    test_agreement();
+    test_word_boundary();
+    test_repeat();
+    test_flush();
+    test_no_timestamps();
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+// Checks the polyphase resampler: passthrough, the output length for any split of the
+// input into blocks, the bound of max_output(), and that a tone comes out in time.
+
+#define _USE_MATH_DEFINES // for M_PI
+
+#include <resampler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+// rate pairs to whisper's 16 kHz and back, and one that needs more phases than there are
+static const int k_rates[][2] = {
+    { 44100, 16000 }, { 48000, 16000 }, { 22050, 16000 }, { 8000, 16000 }, { 11025, 16000 },
+    { 16000, 48000 }, { 44100, 16001 },
+};
+
+static std::vector<float> tone(int rate, double freq, size_t n) {
+    std::vector<float> x(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = 0.5f*sin(2.0*M_PI*freq*i/rate);
+    }
+
+    return x;
+}
+
+// the whole of in through r in blocks of random length, flushed at the end
+static std::vector<float> resample(resampler & r, const std::vector<float> & in, std::mt19937 & rng, size_t block_max, bool & bounded) {
+    std::uniform_int_distribution<size_t> block(0, block_max);
+
+    std::vector<float> out;
+    bounded = true;
+
+    for (size_t pos = 0; pos < in.size(); ) {
+        const size_t n_in = std::min(block(rng), in.size() - pos);
+
+        const size_t n_max = r.max_output(n_in);
+        std::vector<float> buf(n_max + 1);
+
+        const size_t n = r.process(in.data() + pos, n_in, buf.data());
+        bounded &= n <= n_max;
+
+        out.insert(out.end(), buf.begin(), buf.begin() + n);
+        pos += n_in;
+    }
+
+    const size_t n_max = r.max_output(0);
+    std::vector<float> buf(n_max + 1);
+
+    const size_t n = r.flush(buf.data());
+    bounded &= n <= n_max;
+
+    out.insert(out.end(), buf.begin(), buf.begin() + n);
+
+    return out;
+}
+
+static void test_passthrough() {
+    resampler r(16000, 16000);
+    CHECK(r.passthrough(), "equal rates are not a passthrough");
+    CHECK(r.max_output(123) == 123, "max_output %zu instead of 123", r.max_output(123));
+
+    const auto in = tone(16000, 440.0, 1000);
+    std::vector<float> out(in.size());
+
+    CHECK(r.process(in.data(), in.size(), out.data()) == in.size() && out == in, "passthrough changed the samples");
+    CHECK(r.flush(out.data()) == 0, "passthrough flushed samples");
+
+    CHECK(!resampler(44100, 16000).passthrough(), "44100 to 16000 is a passthrough");
+}
+
+static void test_length() {
+    for (const auto & rates : k_rates) {
+        const int rate_in  = rates[0];
+        const int rate_out = rates[1];
+
+        std::mt19937 rng(42);
+
+        const size_t lengths[] = { 0, 1, 7, 1000, 44100 + 17 };
+        const size_t blocks[]  = { 1, 100, 4096 };
+
+        for (size_t n_in : lengths) {
+            const auto in = tone(rate_in, 440.0, n_in);
+
+            // one output sample for every output period that starts within the input
+            const size_t n_expected = ((uint64_t) n_in*rate_out + rate_in - 1)/rate_in;
+
+            for (size_t block_max : blocks) {
+                resampler r(rate_in, rate_out);
+
+                bool bounded = false;
+                const auto out = resample(r, in, rng, block_max, bounded);
+
+                CHECK(out.size() == n_expected, "%d to %d Hz, %zu samples in blocks up to %zu: %zu out instead of %zu", rate_in, rate_out, n_in, block_max, out.size(), n_expected);
+                CHECK(bounded, "%d to %d Hz, %zu samples in blocks up to %zu: more than max_output()", rate_in, rate_out, n_in, block_max);
+            }
+        }
+    }
+}
+
+static void test_blocks() {
+    // the output does not depend on how the input is split, and a flushed resampler starts over
+    for (const auto & rates : k_rates) {
+        std::mt19937 rng(7);
+
+        const auto in = tone(rates[0], 1000.0, 10000);
+
+        resampler r(rates[0], rates[1]);
+
+        bool bounded = false;
+        const auto whole = resample(r, in, rng, in.size(), bounded);
+        const auto split = resample(r, in, rng, 50, bounded);
+
+        bool same = whole.size() == split.size();
+        for (size_t i = 0; same && i < whole.size(); i++) {
+            same = fabsf(whole[i] - split[i]) <= 1e-6f;
+        }
+
+        CHECK(same, "%d to %d Hz: output depends on the block sizes", rates[0], rates[1]);
+    }
+}
+
+static void test_tone() {
+    // a tone well below both Nyquist frequencies comes out as the same tone, without delay
+    for (const auto & rates : k_rates) {
+        const int rate_in  = rates[0];
+        const int rate_out = rates[1];
+        const double freq  = 440.0;
+
+        std::mt19937 rng(1);
+
+        resampler r(rate_in, rate_out);
+
+        bool bounded = false;
+        const auto out = resample(r, tone(rate_in, freq, rate_in), rng, 1024, bounded);
+        const auto expected = tone(rate_out, freq, out.size());
+
+        // away from the edges, where the filter sees the silence around the tone
+        float err_max = 0.0f;
+        for (size_t i = out.size()/10; i < out.size() - out.size()/10; i++) {
+            err_max = std::max(err_max, fabsf(out[i] - expected[i]));
+        }
+
+        CHECK(err_max < 1e-3f, "%d to %d Hz: tone off by %g", rate_in, rate_out, err_max);
+    }
+}
+
+int main() {
+    test_passthrough();
+    test_length();
+    test_blocks();
+    test_tone();
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Checks the adaptive step/length controller: the bounds are widened to the configured
+// values, it never leaves them, and follows the measured real-time factor within them.
+
+#include <rtf_controller.h>
+
+#include <cstdio>
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+static bool within_bounds(const rtf_controller & c, const rtf_controller_params & p) {
+    return c.step_ms() >= p.step_ms_min && c.step_ms() <= p.step_ms_max &&
+           c.length_ms() >= p.length_ms_min && c.length_ms() <= p.length_ms_max &&
+           c.step_ms() <= c.length_ms();
+}
+
+static void test_start() {
+    rtf_controller_params p;
+
+    rtf_controller c(p, 1000, 10000);
+    CHECK(c.step_ms() == 1000 && c.length_ms() == 10000, "started at %d/%d instead of 1000/10000", c.step_ms(), c.length_ms());
+    CHECK(c.rtf() == 0.0f, "rtf %g before any decode", c.rtf());
+
+    // outside the bounds the configured values are clamped into them
+    rtf_controller out(p, 100, 60000);
+    CHECK(out.step_ms() == p.step_ms_min && out.length_ms() == p.length_ms_max, "clamped to %d/%d", out.step_ms(), out.length_ms());
+
+    // nothing measured
+    out.update(100.0, 0.0);
+    CHECK(out.rtf() == 0.0f && out.step_ms() == p.step_ms_min, "update without audio");
+}
+
+static void test_follow() {
+    rtf_controller_params p;
+
+    // a fast decoder: rtf 0.05 over 10 s takes 714 ms of a step, rounded up to 800
+    rtf_controller fast(p, 2000, 10000);
+    for (int i = 0; i < 50; i++) {
+        fast.update(500.0, 10000.0);
+    }
+    CHECK(fast.step_ms() == 800 && fast.length_ms() == 10000, "fast decoder at %d/%d", fast.step_ms(), fast.length_ms());
+    CHECK(fast.rtf() > 0.049f && fast.rtf() < 0.051f, "rtf %g instead of 0.05", fast.rtf());
+
+    // rtf 0.3: the step leaves the decoder target_load of its time, rounded up to 100 ms
+    rtf_controller mid(p, 1000, 10000);
+    for (int i = 0; i < 50; i++) {
+        mid.update(3000.0, 10000.0);
+    }
+    CHECK(mid.step_ms() == 4300 && mid.length_ms() == 10000, "rtf 0.3 at %d/%d instead of 4300/10000", mid.step_ms(), mid.length_ms());
+
+    // even faster: the shortest step
+    rtf_controller fastest(p, 2000, 10000);
+    for (int i = 0; i < 50; i++) {
+        fastest.update(100.0, 10000.0);
+    }
+    CHECK(fastest.step_ms() == p.step_ms_min, "fastest decoder at %d/%d", fastest.step_ms(), fastest.length_ms());
+
+    // too slow for the window even at the longest step: the window shrinks down to its minimum,
+    // and the step can be no longer than the window
+    rtf_controller slow(p, 1000, 10000);
+    for (int i = 0; i < 50; i++) {
+        slow.update(20000.0, 10000.0);
+    }
+    CHECK(slow.length_ms() == p.length_ms_min && slow.step_ms() == p.length_ms_min, "slow decoder at %d/%d", slow.step_ms(), slow.length_ms());
+
+    CHECK(within_bounds(fast, p) && within_bounds(fastest, p) && within_bounds(mid, p) && within_bounds(slow, p), "left the bounds");
+}
+
+static void test_crossed_bounds() {
+    // bounds that cross, as a caller may pass them: no undefined clamp, the lower bound wins
+    rtf_controller_params p;
+    p.step_ms_min   = 2000;
+    p.step_ms_max   = 1000;
+    p.length_ms_min = 1000;
+    p.length_ms_max = 500;
+
+    rtf_controller c(p, 500, 30000);
+    CHECK(c.step_ms() == 2000 && c.length_ms() == 1000, "crossed bounds start at %d/%d", c.step_ms(), c.length_ms());
+
+    const double rtfs[] = { 0.01, 0.5, 3.0 };
+    for (double rtf : rtfs) {
+        for (int i = 0; i < 10; i++) {
+            c.update(rtf * 1000.0, 1000.0);
+        }
+        CHECK(c.step_ms() == 2000 && c.length_ms() == 1000, "crossed bounds at rtf %g: %d/%d", rtf, c.step_ms(), c.length_ms());
+    }
+}
+
+static void test_fit_bounds() {
+    // the defaults hold step 1000/length 10000
+    rtf_controller_params p;
+    CHECK(rtf_controller_fit_bounds(p, 1000, 10000), "default bounds changed");
+
+    // an explicit step and length below and above the bounds widen them instead of being clamped
+    CHECK(!rtf_controller_fit_bounds(p, 300, 30000), "bounds not widened");
+    CHECK(p.step_ms_min == 300 && p.length_ms_max == 30000, "widened to step %d-%d, length %d-%d", p.step_ms_min, p.step_ms_max, p.length_ms_min, p.length_ms_max);
+
+    rtf_controller c(p, 300, 30000);
+    CHECK(c.step_ms() == 300 && c.length_ms() == 30000, "started at %d/%d instead of 300/30000", c.step_ms(), c.length_ms());
+
+    // crossed bounds come out ordered, and the window is never shorter than the step
+    rtf_controller_params crossed;
+    crossed.step_ms_min   = 4000;
+    crossed.step_ms_max   = 1000;
+    crossed.length_ms_min = 20000;
+    crossed.length_ms_max = 2000;
+
+    CHECK(!rtf_controller_fit_bounds(crossed, 2000, 8000), "crossed bounds not fixed");
+    CHECK(crossed.step_ms_min <= 2000 && 2000 <= crossed.step_ms_max, "step bounds %d-%d", crossed.step_ms_min, crossed.step_ms_max);
+    CHECK(crossed.length_ms_min <= 8000 && 8000 <= crossed.length_ms_max, "length bounds %d-%d", crossed.length_ms_min, crossed.length_ms_max);
+    CHECK(crossed.length_ms_min >= crossed.step_ms_min, "length_ms_min %d below step_ms_min %d", crossed.length_ms_min, crossed.step_ms_min);
+
+    rtf_controller d(crossed, 2000, 8000);
+    const double rtfs[] = { 0.01, 0.5, 3.0 };
+    for (double rtf : rtfs) {
+        for (int i = 0; i < 10; i++) {
+            d.update(rtf * 1000.0, 1000.0);
+        }
+        CHECK(within_bounds(d, crossed), "fitted bounds left at rtf %g: %d/%d", rtf, d.step_ms(), d.length_ms());
+    }
+}
+
+int main() {
+    test_start();
+    test_follow();
+    test_crossed_bounds();
+    test_fit_bounds();
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+// Checks how transcribe_split() cuts a recording: every burst of sound ends up in a
+// chunk, long pauses in none, no chunk is longer than chunk_ms, and long speech is
+// cut into pieces of about the same length.
+
+#include <transcribe.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+static const size_t k_rate = 16000;
+
+static size_t at(double s) {
+    return (size_t) (s*k_rate);
+}
+
+// noise as the stand-in for speech, near silence for the pauses
+struct part {
+    double seconds;
+    bool   speech;
+};
+
+static const part k_parts[] = {
+    { 1.0, false }, { 2.0, true }, { 3.0, false }, { 0.5, true }, { 3.0, false }, { 10.0, true }, { 2.0, false },
+};
+
+static std::vector<float> recording() {
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+
+    std::vector<float> pcm;
+    for (const auto & p : k_parts) {
+        for (size_t i = 0; i < at(p.seconds); i++) {
+            pcm.push_back((p.speech ? 0.3f : 1e-3f)*noise(rng));
+        }
+    }
+
+    return pcm;
+}
+
+static bool covered(const std::vector<transcribe_chunk> & chunks, size_t pos) {
+    for (const auto & chunk : chunks) {
+        if (chunk.begin <= pos && pos < chunk.end) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void test_chunks() {
+    const auto pcm = recording();
+
+    transcribe_params params;
+    params.chunk_ms = 3000;
+
+    const size_t n_chunk = at(params.chunk_ms/1000.0);
+
+    const auto chunks = transcribe_split(pcm, params);
+    CHECK(!chunks.empty(), "no chunks");
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const auto & chunk = chunks[i];
+
+        CHECK(chunk.begin < chunk.end && chunk.end <= pcm.size(), "chunk %zu is %zu-%zu", i, chunk.begin, chunk.end);
+        CHECK(chunk.end - chunk.begin <= n_chunk, "chunk %zu is %zu samples long", i, chunk.end - chunk.begin);
+        CHECK(i == 0 || chunks[i - 1].end <= chunk.begin, "chunk %zu overlaps the one before", i);
+    }
+
+    // all of the speech, and the middle of each long pause not at all
+    double t = 0.0;
+    for (const auto & p : k_parts) {
+        if (p.speech) {
+            bool all = true;
+            for (size_t pos = at(t); pos < at(t + p.seconds); pos++) {
+                all &= covered(chunks, pos);
+            }
+            CHECK(all, "speech at %.1f s not in any chunk", t);
+        } else if (p.seconds >= 3.0) {
+            CHECK(!covered(chunks, at(t + p.seconds/2)), "pause at %.1f s decoded", t + p.seconds/2);
+        }
+
+        t += p.seconds;
+    }
+
+    // the 10 s of speech from 9.5 s are cut into pieces of at least half a chunk, no short leftover
+    int n_pieces = 0;
+    for (const auto & chunk : chunks) {
+        if (chunk.end > at(9.5) && chunk.begin < at(19.5)) {
+            ++n_pieces;
+            CHECK(chunk.end - chunk.begin >= n_chunk/2, "piece %zu-%zu of the long speech is short", chunk.begin, chunk.end);
+        }
+    }
+    CHECK(n_pieces >= 4, "long speech in %d pieces", n_pieces);
+}
+
+static void test_merge() {
+    // with whisper's 30 s, the bursts and the pauses between them are decoded at once
+    const auto pcm = recording();
+
+    const auto chunks = transcribe_split(pcm, transcribe_params());
+    CHECK(chunks.size() == 1, "%zu chunks instead of 1", chunks.size());
+    CHECK(!chunks.empty() && chunks[0].begin <= at(1.0) && chunks[0].end >= at(19.5), "chunk does not hold all of the speech");
+}
+
+int main() {
+    test_chunks();
+    test_merge();
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
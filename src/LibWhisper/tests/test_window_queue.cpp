@@ -0,0 +1,154 @@
+// Checks the window queue: order, the overflow policies and what they count, and
+// that neither side waits longer than it was told to.
+
+#include <window_queue.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static int n_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        ++n_failed; \
+    } \
+} while (0)
+
+// steps of 100 samples over windows of 300, as the assembler cuts them in fixed step mode
+static stream_window step(uint64_t i) {
+    return stream_window { i*100, i*100 + 300, false, false };
+}
+
+static stream_stats_t stats_of(window_queue & queue) {
+    stream_stats_t stats {};
+    queue.get_stats(stats);
+
+    return stats;
+}
+
+static void test_order() {
+    window_queue queue(4, STREAM_OVERFLOW_DROP_OLDEST, 1000);
+
+    for (uint64_t i = 0; i < 3; i++) {
+        queue.push(step(i));
+    }
+
+    const auto stats = stats_of(queue);
+    CHECK(stats.queue_depth == 3 && stats.queue_depth_max == 3 && stats.n_windows == 3, "depth %d, max %d, %llu pushed", stats.queue_depth, stats.queue_depth_max, (unsigned long long) stats.n_windows);
+
+    for (uint64_t i = 0; i < 3; i++) {
+        stream_window window;
+        CHECK(queue.pop(window, 0) && window.begin == i*100 && window.size() == 300 && !window.degraded, "window %llu out of order", (unsigned long long) i);
+    }
+
+    stream_window window;
+    CHECK(!queue.pop(window, 10), "popped from an empty queue");
+    CHECK(stats_of(queue).n_decoded == 3, "%llu decoded", (unsigned long long) stats_of(queue).n_decoded);
+}
+
+static void test_drop_oldest() {
+    window_queue queue(2, STREAM_OVERFLOW_DROP_OLDEST, 1000);
+
+    for (uint64_t i = 0; i < 4; i++) {
+        queue.push(step(i));
+    }
+
+    // windows 0 and 1 went, each took the 100 samples before the next window with it
+    const auto stats = stats_of(queue);
+    CHECK(stats.n_dropped == 2 && stats.n_samples_dropped == 200, "%llu dropped, %llu samples", (unsigned long long) stats.n_dropped, (unsigned long long) stats.n_samples_dropped);
+    CHECK(stats.queue_depth == 2 && stats.queue_depth_max == 2, "depth %d beyond the capacity", stats.queue_depth);
+
+    stream_window window;
+    CHECK(queue.pop(window, 0) && window.begin == 200, "oldest left is %llu instead of 200", (unsigned long long) window.begin);
+
+    // windows that do not overlap lose all of their audio
+    window_queue gaps(1, STREAM_OVERFLOW_DROP_OLDEST, 1000);
+    gaps.push(stream_window { 0, 100, false, false });
+    gaps.push(stream_window { 500, 600, false, false });
+    CHECK(stats_of(gaps).n_samples_dropped == 100, "%llu samples dropped instead of 100", (unsigned long long) stats_of(gaps).n_samples_dropped);
+}
+
+static void test_coalesce() {
+    window_queue queue(1, STREAM_OVERFLOW_COALESCE, 1000);
+
+    queue.push(step(0));
+    queue.push(stream_window { 100, 400, true, false });
+    queue.push(step(2));
+
+    // one window from 0 to 500, the end of the line kept
+    auto stats = stats_of(queue);
+    CHECK(stats.n_coalesced == 2 && stats.n_dropped == 0 && stats.queue_depth == 1, "%llu coalesced, %llu dropped", (unsigned long long) stats.n_coalesced, (unsigned long long) stats.n_dropped);
+
+    stream_window window;
+    CHECK(queue.pop(window, 0) && window.begin == 0 && window.end == 500 && window.new_line, "coalesced into %llu-%llu", (unsigned long long) window.begin, (unsigned long long) window.end);
+
+    // past whisper's limit, or with a gap, the oldest is dropped instead
+    queue.push(stream_window { 0, 900, false, false });
+    queue.push(stream_window { 500, 1100, false, false });
+    queue.push(stream_window { 2000, 2100, false, false });
+
+    stats = stats_of(queue);
+    CHECK(stats.n_coalesced == 2 && stats.n_dropped == 2, "%llu coalesced, %llu dropped", (unsigned long long) stats.n_coalesced, (unsigned long long) stats.n_dropped);
+    CHECK(queue.pop(window, 0) && window.begin == 2000, "kept %llu instead of 2000", (unsigned long long) window.begin);
+}
+
+static void test_degrade() {
+    window_queue queue(2, STREAM_OVERFLOW_DEGRADE, 1000);
+
+    // the first one finds the decoder idle, the others behind
+    for (uint64_t i = 0; i < 3; i++) {
+        queue.push(step(i));
+    }
+
+    const auto stats = stats_of(queue);
+    CHECK(stats.n_degraded == 2 && stats.n_dropped == 1, "%llu degraded, %llu dropped", (unsigned long long) stats.n_degraded, (unsigned long long) stats.n_dropped);
+
+    stream_window window;
+    CHECK(queue.pop(window, 0) && window.begin == 100 && window.degraded, "window %llu not degraded", (unsigned long long) window.begin);
+}
+
+static void test_wait() {
+    window_queue queue(1, STREAM_OVERFLOW_DROP_OLDEST, 1000);
+
+    CHECK(queue.wait_for_space(0), "no space in an empty queue");
+
+    queue.push(step(0));
+    CHECK(!queue.wait_for_space(10), "space in a full queue");
+
+    // the decoder takes the window while the assembler waits for space
+    std::thread decoder([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        stream_window window;
+        queue.pop(window, 0);
+    });
+
+    CHECK(queue.wait_for_space(5000), "not woken by pop()");
+    decoder.join();
+
+    // and the other way round
+    std::thread assembler([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.push(step(1));
+    });
+
+    stream_window window;
+    CHECK(queue.pop(window, 5000) && window.begin == 100, "not woken by push()");
+    assembler.join();
+}
+
+int main() {
+    test_order();
+    test_drop_oldest();
+    test_coalesce();
+    test_degrade();
+    test_wait();
+
+    fprintf(stderr, "%s\n", n_failed == 0 ? "OK" : "FAILED");
+
+    return n_failed == 0 ? 0 : 1;
+}
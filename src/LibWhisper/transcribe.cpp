@@ -0,0 +1,217 @@
+#include "transcribe.h"
+
+#include "common.h"
+#include "dsp.h"
+#include "vad_stream.h"
+#include "whisper_model.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+// resolution of the search for a quiet cut point in speech longer than a chunk
+#define TRANSCRIBE_FRAME_MS 100
+
+// shorter chunks are padded with silence, whisper does not decode less than a second
+#define TRANSCRIBE_MIN_MS 1100
+
+// the quietest frame in [begin, end) of pcmf32
+static size_t transcribe_find_pause(const std::vector<float> & pcmf32, size_t begin, size_t end) {
+    const auto & dsp = dsp_get_kernels();
+    const size_t n_frame = (WHISPER_SAMPLE_RATE * TRANSCRIBE_FRAME_MS) / 1000;
+
+    size_t best = end;
+    float energy_min = INFINITY;
+
+    for (size_t pos = begin; pos + n_frame <= end; pos += n_frame) {
+        const float energy = dsp.sum_abs(pcmf32.data() + pos, n_frame);
+        if (energy < energy_min) {
+            energy_min = energy;
+            best = pos + n_frame/2;
+        }
+    }
+
+    return best;
+}
+
+std::vector<transcribe_chunk> transcribe_split(const std::vector<float> & pcmf32, const transcribe_params & params) {
+    const size_t n_samples = pcmf32.size();
+    const size_t n_chunk = ((size_t) WHISPER_SAMPLE_RATE * params.chunk_ms) / 1000;
+
+    vad_stream_params vparams;
+    vparams.sample_rate = WHISPER_SAMPLE_RATE;
+    vparams.vad_thold   = params.vad_thold;
+    vparams.freq_thold  = params.freq_thold;
+
+    const size_t n_last = ((size_t) WHISPER_SAMPLE_RATE * vparams.last_ms) / 1000;
+
+    vad_stream vad(vparams);
+    std::vector<vad_event> events;
+    vad.process(pcmf32.data(), n_samples, events);
+
+    // speech regions; the audio may start with speech, which the VAD only reports the end of
+    std::vector<transcribe_chunk> speech;
+    {
+        bool   speaking = true;
+        size_t begin    = 0;
+        size_t end_prev = 0;
+
+        for (const auto & event : events) {
+            const size_t pos = std::min<size_t>(event.offset, n_samples);
+
+            if (event.type == vad_event::speech_start) {
+                // the detector only notices speech once it dominates the last part of its window
+                begin = std::max(end_prev, pos - std::min(pos, n_last));
+                speaking = true;
+            } else {
+                speech.push_back({ speaking ? begin : end_prev, pos });
+                speaking = false;
+                end_prev = pos;
+            }
+        }
+
+        if (speaking && begin < n_samples) {
+            speech.push_back({ begin, n_samples });
+        }
+    }
+
+    std::vector<transcribe_chunk> chunks;
+
+    for (auto region : speech) {
+        // cut speech longer than a chunk into pieces of about the same length, at the quietest
+        // moment near each cut, so that no short leftover piece is decoded on its own
+        while (region.end - region.begin > n_chunk) {
+            const size_t n_pieces = (region.end - region.begin + n_chunk - 1) / n_chunk;
+            const size_t target   = region.begin + (region.end - region.begin) / n_pieces;
+
+            const size_t cut = transcribe_find_pause(pcmf32, target - n_chunk/4, std::min(target + n_chunk/4, region.begin + n_chunk));
+
+            chunks.push_back({ region.begin, cut });
+            region.begin = cut;
+        }
+
+        // merge short regions, including the pause between them
+        if (!chunks.empty() && region.end - chunks.back().begin <= n_chunk) {
+            chunks.back().end = region.end;
+        } else {
+            chunks.push_back(region);
+        }
+    }
+
+    return chunks;
+}
+
+bool transcribe_pcm(
+        const std::shared_ptr<whisper_context> & model,
+        const std::vector<float> & pcmf32,
+        const transcribe_params & params,
+        OrderedSegments & result) {
+    const auto chunks = transcribe_split(pcmf32, params);
+    if (chunks.empty()) {
+        return true;
+    }
+
+    int n_workers = params.n_workers > 0 ? params.n_workers : std::max(1, params.n_threads / 4);
+    n_workers = std::min<int>(n_workers, chunks.size());
+
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+
+    wparams.print_progress   = false;
+    wparams.print_special    = false;
+    wparams.print_realtime   = false;
+    wparams.print_timestamps = false;
+    wparams.translate        = params.translate;
+    wparams.language         = params.language.c_str();
+    wparams.n_threads        = std::max(1, params.n_threads / n_workers);
+
+    // chunks are decoded out of order, so the text of one cannot prompt the next
+    wparams.no_context = true;
+
+    std::vector<OrderedSegments> segments(chunks.size());
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+
+    auto worker = [&]() {
+        auto state = whisper_model_new_state(model);
+        if (state == nullptr) {
+            fprintf(stderr, "%s: failed to allocate whisper state\n", __func__);
+            failed = true;
+            return;
+        }
+
+        const size_t n_samples_min = (TRANSCRIBE_MIN_MS * WHISPER_SAMPLE_RATE) / 1000;
+        std::vector<float> padded;
+
+        for (size_t i = next++; i < chunks.size() && !failed; i = next++) {
+            const auto & chunk = chunks[i];
+
+            const float * samples   = pcmf32.data() + chunk.begin;
+            size_t        n_samples = chunk.end - chunk.begin;
+
+            // an isolated short utterance would otherwise come back without any segment
+            if (n_samples < n_samples_min) {
+                padded.assign(n_samples_min, 0.0f);
+                std::copy(samples, samples + n_samples, padded.begin());
+
+                samples   = padded.data();
+                n_samples = padded.size();
+            }
+
+            if (whisper_full_with_state(model.get(), state.get(), wparams, samples, n_samples) != 0) {
+                fprintf(stderr, "%s: failed to process audio\n", __func__);
+                failed = true;
+                return;
+            }
+
+            const int64_t t0 = ((int64_t) chunk.begin * 1000) / WHISPER_SAMPLE_RATE;
+            const int64_t t1 = ((int64_t) chunk.end * 1000) / WHISPER_SAMPLE_RATE;
+
+            const int n_segments = whisper_full_n_segments_from_state(state.get());
+            for (int j = 0; j < n_segments; ++j) {
+                // segment timestamps are in units of 10 ms relative to the chunk
+                segments[i].push_back(Segment {
+                    whisper_full_get_segment_text_from_state(state.get(), j),
+                    (uint64_t) std::min(t1, t0 + whisper_full_get_segment_t0_from_state(state.get(), j) * 10),
+                    (uint64_t) std::min(t1, t0 + whisper_full_get_segment_t1_from_state(state.get(), j) * 10),
+                });
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        for (int i = 1; i < n_workers; ++i) {
+            workers.emplace_back(worker);
+        }
+
+        worker();
+    }
+
+    if (failed) {
+        return false;
+    }
+
+    for (auto & chunk : segments) {
+        result.insert(result.end(), std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+    }
+
+    return true;
+}
+
+bool transcribe_file(
+        const std::shared_ptr<whisper_context> & model,
+        const std::string & fname,
+        const transcribe_params & params,
+        OrderedSegments & result) {
+    std::vector<float> pcmf32;
+    std::vector<std::vector<float>> pcmf32s;
+
+    if (!read_wav(fname, pcmf32, pcmf32s, false)) {
+        fprintf(stderr, "%s: failed to read WAV file '%s'\n", __func__, fname.c_str());
+        return false;
+    }
+
+    return transcribe_pcm(model, pcmf32, params, result);
+}
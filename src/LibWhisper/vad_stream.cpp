@@ -0,0 +1,95 @@
+#define _USE_MATH_DEFINES // for M_PI
+
+#include "vad_stream.h"
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+
+vad_stream::vad_stream(const vad_stream_params & params) : m_params(params) {
+    m_n_window = std::max(1, (m_params.sample_rate * m_params.window_ms) / 1000);
+    m_n_last   = std::min<size_t>(std::max(1, (m_params.sample_rate * m_params.last_ms) / 1000), m_n_window);
+
+    // same filter as high_pass_filter()
+    if (m_params.freq_thold > 0.0f) {
+        const float rc = 1.0f / (2.0f * M_PI * m_params.freq_thold);
+        const float dt = 1.0f / m_params.sample_rate;
+        m_alpha = dt / (rc + dt);
+    }
+
+    m_energy.resize(m_n_window);
+
+    reset();
+}
+
+void vad_stream::reset() {
+    std::fill(m_energy.begin(), m_energy.end(), 0.0f);
+
+    m_y_prev   = 0.0f;
+    m_sum_all  = 0.0;
+    m_sum_last = 0.0;
+    m_pos      = 0;
+    m_pos_hold = 0;
+
+    m_speaking   = false;
+    m_start_prev = false;
+    m_end_prev   = false;
+}
+
+void vad_stream::process(const float * data, size_t n_samples, std::vector<vad_event> & events) {
+    const double thold = m_params.vad_thold;
+    const size_t n_hold = (m_params.sample_rate * m_params.hold_ms) / 1000;
+
+    if (m_alpha > 0.0f && n_samples > 0) {
+        m_filtered.assign(data, data + n_samples);
+
+        // like high_pass_filter(), the very first sample passes through unchanged
+        const size_t n_skip = m_pos == 0 ? 1 : 0;
+        if (n_skip) {
+            m_y_prev = m_filtered[0];
+        }
+
+        m_y_prev = dsp_get_kernels().high_pass(m_filtered.data() + n_skip, n_samples - n_skip, m_alpha, m_y_prev);
+        data = m_filtered.data();
+    }
+
+    for (size_t i = 0; i < n_samples; i++) {
+        const float e = fabsf(data[i]);
+
+        // slide both sums by one sample
+        float & e_out_all = m_energy[m_pos % m_n_window];
+        const float e_out_last = m_energy[(m_pos + m_n_window - m_n_last) % m_n_window];
+
+        m_sum_all  += e - e_out_all;
+        m_sum_last += e - e_out_last;
+        e_out_all = e;
+
+        ++m_pos;
+
+        if (m_pos < m_n_window) {
+            continue;
+        }
+
+        const double energy_all   = m_sum_all / m_n_window;
+        const double energy_last  = m_sum_last / m_n_last;
+        const double energy_first = m_n_window > m_n_last ? (m_sum_all - m_sum_last) / (m_n_window - m_n_last) : energy_last;
+
+        const bool start = energy_first <= thold*energy_all && energy_last > thold*energy_all;
+        const bool end   = energy_last <= thold*energy_all;
+
+        if (start && !m_start_prev && !m_speaking && m_pos >= m_pos_hold) {
+            m_speaking = true;
+            events.push_back({ vad_event::speech_start, m_pos });
+        }
+
+        // a falling edge without a start still counts, speech may have begun before the stream did
+        if (end && !m_end_prev && (m_speaking || m_pos >= m_pos_hold)) {
+            m_speaking = false;
+            m_pos_hold = m_pos + n_hold;
+            events.push_back({ vad_event::speech_end, m_pos });
+        }
+
+        m_start_prev = start;
+        m_end_prev   = end;
+    }
+}
@@ -0,0 +1,265 @@
+#include "wav_reader.h"
+
+#include "common.h"
+#include "dsp.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#ifdef WHISPER_FFMPEG
+// as implemented in ffmpeg_trancode.cpp only embedded in common lib if whisper built with ffmpeg support
+extern bool ffmpeg_decode_audio(const std::string & ifname, std::vector<uint8_t> & wav_data);
+#endif
+
+wav_reader::~wav_reader() {
+    close();
+}
+
+bool wav_reader::open(const std::string & fname) {
+    if (fname == "-") {
+        #ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        #endif
+
+        return open_pipe(stdin);
+    }
+
+    if (is_wav_buffer(fname)) {
+        return open_memory(fname.data(), fname.size());
+    }
+
+    return open_file(fname);
+}
+
+bool wav_reader::open_file(const std::string & path) {
+    close();
+
+    if (drwav_init_file(&m_wav, path.c_str(), nullptr) == false) {
+#if defined(WHISPER_FFMPEG)
+        if (ffmpeg_decode_audio(path, m_data) != 0) {
+            fprintf(stderr, "error: failed to ffmpeg decode '%s' \n", path.c_str());
+            return false;
+        }
+        if (drwav_init_memory(&m_wav, m_data.data(), m_data.size(), nullptr) == false) {
+            fprintf(stderr, "error: failed to read wav data as wav \n");
+            return false;
+        }
+#else
+        fprintf(stderr, "error: failed to open '%s' as WAV file\n", path.c_str());
+        return false;
+#endif
+    }
+
+    return init(path.c_str());
+}
+
+bool wav_reader::open_memory(const void * data, size_t size) {
+    close();
+
+    if (drwav_init_memory(&m_wav, data, size, nullptr) == false) {
+        fprintf(stderr, "error: failed to open WAV file from buffer\n");
+        return false;
+    }
+
+    return init("buffer");
+}
+
+bool wav_reader::open_pipe(FILE * stream) {
+    close();
+
+    m_pipe = stream;
+    m_pipe_pos = 0;
+
+    // sequential: parse the header in one pass, without going back to the data chunk
+    if (drwav_init_ex(&m_wav, pipe_read, pipe_seek, nullptr, this, nullptr, DRWAV_SEQUENTIAL, nullptr) == false) {
+        fprintf(stderr, "error: failed to open WAV file from pipe\n");
+        m_pipe = nullptr;
+        return false;
+    }
+
+    // the writer could not go back to fill in the size, read until the pipe ends
+    if (m_wav.dataChunkDataSize == 0) {
+        m_wav.bytesRemaining = UINT64_MAX;
+        m_wav.totalPCMFrameCount = UINT64_MAX;
+    }
+
+    if (!init("pipe")) {
+        return false;
+    }
+
+    // the header of a pipe cannot be trusted with the length
+    m_n_frames = 0;
+
+    return true;
+}
+
+void wav_reader::close() {
+    if (m_open) {
+        drwav_uninit(&m_wav);
+    }
+
+    m_open = false;
+    m_n_frames = 0;
+    m_pipe = nullptr;
+    m_data.clear();
+
+    m_sample_rate = 0;
+    m_eof = false;
+    for (int c = 0; c < 3; c++) {
+        m_resamplers[c] = resampler();
+        m_pending[c].clear();
+    }
+}
+
+void wav_reader::set_sample_rate(int sample_rate) {
+    m_sample_rate = sample_rate;
+    m_eof = false;
+
+    for (int c = 0; c < 3; c++) {
+        m_resamplers[c] = resampler(m_wav.sampleRate, sample_rate);
+        m_pending[c].clear();
+    }
+
+    if (m_n_frames > 0) {
+        m_n_frames = (m_wav.totalPCMFrameCount*sample_rate + m_wav.sampleRate - 1)/m_wav.sampleRate;
+    }
+}
+
+size_t wav_reader::read(float * mono, size_t n_frames) {
+    return read(mono, nullptr, nullptr, n_frames);
+}
+
+size_t wav_reader::read(float * mono, float * left, float * right, size_t n_frames) {
+    if (m_resamplers[0].passthrough()) {
+        return read_native(mono, left, right, n_frames);
+    }
+
+    const int n_channels = left != nullptr ? 3 : 1;
+
+    // resample whole blocks until there is enough, the rest waits for the next read
+    while (m_pending[0].size() < n_frames && !m_eof) {
+        for (int c = 0; c < n_channels; c++) {
+            m_native[c].resize(WAV_READER_RESAMPLE_BLOCK);
+        }
+
+        const size_t n_read = read_native(m_native[0].data(),
+                n_channels > 1 ? m_native[1].data() : nullptr,
+                n_channels > 1 ? m_native[2].data() : nullptr, WAV_READER_RESAMPLE_BLOCK);
+
+        m_eof = n_read < WAV_READER_RESAMPLE_BLOCK;
+
+        for (int c = 0; c < n_channels; c++) {
+            auto & r = m_resamplers[c];
+            auto & pending = m_pending[c];
+
+            size_t n = pending.size();
+            pending.resize(n + r.max_output(n_read));
+            n += r.process(m_native[c].data(), n_read, pending.data() + n);
+
+            if (m_eof) {
+                pending.resize(n + r.max_output(0));
+                n += r.flush(pending.data() + n);
+            }
+
+            pending.resize(n);
+        }
+    }
+
+    const size_t n = std::min(n_frames, m_pending[0].size());
+
+    float * dst[3] = { mono, left, right };
+    for (int c = 0; c < n_channels; c++) {
+        memcpy(dst[c], m_pending[c].data(), n*sizeof(float));
+        m_pending[c].erase(m_pending[c].begin(), m_pending[c].begin() + n);
+    }
+
+    return n;
+}
+
+size_t wav_reader::read_native(float * mono, float * left, float * right, size_t n_frames) {
+    const size_t n = read_s16(n_frames);
+
+    const auto & dsp = dsp_get_kernels();
+
+    if (m_wav.channels == 1) {
+        dsp.s16_to_f32(m_pcm16.data(), mono, n);
+        if (left != nullptr) {
+            memcpy(left,  mono, n*sizeof(float));
+            memcpy(right, mono, n*sizeof(float));
+        }
+    } else {
+        dsp.s16_stereo_to_mono_f32(m_pcm16.data(), mono, n);
+        if (left != nullptr) {
+            dsp.s16_stereo_to_f32(m_pcm16.data(), left, right, n);
+        }
+    }
+
+    return n;
+}
+
+bool wav_reader::init(const char * source) {
+    m_open = true;
+
+    if (m_wav.channels != 1 && m_wav.channels != 2) {
+        fprintf(stderr, "%s: WAV file '%s' must be mono or stereo\n", __func__, source);
+        close();
+        return false;
+    }
+
+    m_n_frames = m_wav.totalPCMFrameCount;
+
+    // no conversion until set_sample_rate()
+    m_sample_rate = m_wav.sampleRate;
+
+    return true;
+}
+
+size_t wav_reader::read_s16(size_t n_frames) {
+    if (!m_open) {
+        return 0;
+    }
+
+    m_pcm16.resize(n_frames*m_wav.channels);
+
+    return drwav_read_pcm_frames_s16(&m_wav, n_frames, m_pcm16.data());
+}
+
+size_t wav_reader::pipe_read(void * user_data, void * buf, size_t n_bytes) {
+    auto reader = static_cast<wav_reader *>(user_data);
+
+    const size_t n = fread(buf, 1, n_bytes, reader->m_pipe);
+    reader->m_pipe_pos += n;
+
+    return n;
+}
+
+drwav_bool32 wav_reader::pipe_seek(void * user_data, int offset, drwav_seek_origin origin) {
+    auto reader = static_cast<wav_reader *>(user_data);
+
+    // dr_wav also "seeks" to the data chunk it is already at
+    uint64_t n_skip = offset;
+    if (origin == drwav_seek_origin_start) {
+        n_skip = (uint64_t) offset - reader->m_pipe_pos;
+    }
+
+    // only skipping forward is possible
+    if (offset < 0 || n_skip > (uint64_t) INT32_MAX) {
+        return DRWAV_FALSE;
+    }
+
+    uint8_t buf[4096];
+    while (n_skip > 0) {
+        const size_t n = pipe_read(user_data, buf, std::min<size_t>(n_skip, sizeof(buf)));
+        if (n == 0) {
+            return DRWAV_FALSE;
+        }
+        n_skip -= n;
+    }
+
+    return DRWAV_TRUE;
+}
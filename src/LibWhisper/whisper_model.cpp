@@ -0,0 +1,183 @@
+#include "whisper_model.h"
+
+#include "whisper.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<model_file> model_file::open(const std::string & path, const whisper_model_params & params) {
+    std::shared_ptr<model_file> file(new model_file());
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    file->m_file = handle;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        return nullptr;
+    }
+    file->m_size = size.QuadPart;
+
+    if ((file->m_mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr)) == nullptr) {
+        return nullptr;
+    }
+
+    if ((file->m_data = MapViewOfFile(file->m_mapping, FILE_MAP_READ, 0, 0, 0)) == nullptr) {
+        return nullptr;
+    }
+
+    if (params.willneed) {
+        WIN32_MEMORY_RANGE_ENTRY range = { file->m_data, file->m_size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void * data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file referenced
+
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    file->m_data = data;
+    file->m_size = st.st_size;
+
+#ifdef MADV_HUGEPAGE
+    if (params.hugepages) {
+        madvise(data, file->m_size, MADV_HUGEPAGE);
+    }
+#endif
+
+    if (params.willneed) {
+        posix_madvise(data, file->m_size, POSIX_MADV_WILLNEED);
+    }
+#endif
+
+    return file;
+}
+
+model_file::~model_file() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file) {
+        CloseHandle(m_file);
+    }
+#else
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+#endif
+}
+
+struct whisper_model_entry {
+    std::filesystem::file_time_type mtime;
+
+    std::weak_ptr<whisper_context> model;
+};
+
+static std::mutex g_models_mutex;
+static std::map<std::string, whisper_model_entry> g_models;
+
+std::shared_ptr<whisper_context> whisper_model_acquire(const std::string & path, const whisper_model_params & params) {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        fprintf(stderr, "%s: cannot access model '%s': %s\n", __func__, path.c_str(), ec.message().c_str());
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_models_mutex);
+
+    auto & entry = g_models[path];
+
+    if (entry.mtime != mtime) {
+        // changed on disk: streams using the old model keep their reference to it
+        entry = whisper_model_entry { mtime, {} };
+    }
+
+    if (auto model = entry.model.lock()) {
+        return model;
+    }
+
+    // only needed while loading, whisper copies the weights into its own buffers
+    std::shared_ptr<model_file> file;
+    if (params.use_mmap) {
+        file = model_file::open(path, params);
+        if (file == nullptr) {
+            fprintf(stderr, "%s: failed to map '%s', reading it instead\n", __func__, path.c_str());
+        }
+    }
+
+    // the context only holds the weights, every stream brings its own state
+    whisper_context *ctx = file != nullptr
+        ? whisper_init_from_buffer_with_params_no_state(const_cast<void *>(file->data()), file->size(), whisper_context_default_params())
+        : whisper_init_from_file_with_params_no_state(path.c_str(), whisper_context_default_params());
+
+    if (ctx == nullptr) {
+        fprintf(stderr, "%s: failed to load model '%s'\n", __func__, path.c_str());
+        g_models.erase(path);
+        return nullptr;
+    }
+
+    std::shared_ptr<whisper_context> model(ctx, whisper_free);
+    entry.model = model;
+
+    return model;
+}
+
+void whisper_model_cache_trim() {
+    std::lock_guard<std::mutex> lock(g_models_mutex);
+
+    std::erase_if(g_models, [](const auto & item) {
+        return item.second.model.expired();
+    });
+}
+
+bool whisper_model_lock_memory() {
+#ifdef _WIN32
+    return false;
+#else
+    // whisper does not expose the backend buffers the weights were copied into,
+    // so everything mapped now is locked, which also faults in any page of them
+    // that was swapped out; the model files are no longer mapped at this point
+    return mlockall(MCL_CURRENT) == 0;
+#endif
+}
+
+void whisper_state_deleter::operator()(whisper_state * state) const {
+    whisper_free_state(state);
+}
+
+unique_whisper_state whisper_model_new_state(const std::shared_ptr<whisper_context> & model) {
+    return unique_whisper_state(whisper_init_state(model.get()), whisper_state_deleter { model });
+}
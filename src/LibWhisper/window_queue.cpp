@@ -0,0 +1,96 @@
+#include "window_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+window_queue::window_queue(size_t capacity, stream_overflow_policy_t policy, size_t n_max_samples)
+    : m_capacity(std::max<size_t>(capacity, 1)), m_policy(policy), m_n_max_samples(n_max_samples) {}
+
+void window_queue::push(stream_window && window) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        ++m_n_pushed;
+
+        if (m_policy == STREAM_OVERFLOW_DEGRADE && !m_queue.empty()) {
+            // the decoder is already behind, make this one cheaper
+            window.degraded = true;
+            ++m_n_degraded;
+        }
+
+        if (m_queue.size() >= m_capacity) {
+            if (m_policy == STREAM_OVERFLOW_COALESCE && coalesce(window)) {
+                ++m_n_coalesced;
+                return;
+            }
+
+            // drop the oldest window, the newer ones overlap most of its audio anyway
+            fprintf(stderr, "%s: WARNING: cannot process audio fast enough, dropping audio ...\n", __func__);
+
+            const uint64_t end = m_queue.size() > 1 ? m_queue[1].begin : window.begin;
+            m_n_samples_dropped += end > m_queue.front().begin ? std::min<uint64_t>(end - m_queue.front().begin, m_queue.front().size()) : 0;
+            ++m_n_dropped;
+
+            m_queue.pop_front();
+        }
+
+        m_queue.push_back(std::move(window));
+        m_depth_max = std::max(m_depth_max, m_queue.size());
+    }
+
+    m_cv.notify_one();
+}
+
+bool window_queue::pop(stream_window & window, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return !m_queue.empty(); })) {
+        return false;
+    }
+
+    window = std::move(m_queue.front());
+    m_queue.pop_front();
+
+    ++m_n_decoded;
+
+    lock.unlock();
+    m_cv_space.notify_one();
+
+    return true;
+}
+
+bool window_queue::wait_for_space(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    return m_cv_space.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return m_queue.size() < m_capacity; });
+}
+
+void window_queue::get_stats(stream_stats_t & stats) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    stats.queue_depth       = m_queue.size();
+    stats.queue_depth_max   = m_depth_max;
+    stats.n_windows         = m_n_pushed;
+    stats.n_decoded         = m_n_decoded;
+    stats.n_dropped         = m_n_dropped;
+    stats.n_coalesced       = m_n_coalesced;
+    stats.n_degraded        = m_n_degraded;
+    stats.n_samples_dropped = m_n_samples_dropped;
+}
+
+bool window_queue::coalesce(stream_window & window) {
+    auto & last = m_queue.back();
+
+    // windows are cut from the same capture stream, so they can be joined
+    // as long as there is no gap and the result still fits into whisper's 30 s
+    if (window.begin > last.end || window.end <= last.end || window.end - last.begin > m_n_max_samples) {
+        return false;
+    }
+
+    last.end = window.end;
+    last.new_line |= window.new_line;
+    last.degraded |= window.degraded;
+
+    return true;
+}
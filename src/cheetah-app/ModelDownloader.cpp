@@ -15,12 +15,27 @@ ModelDownloader::ModelDownloader (std::string modelName) : modelName(modelName)
 ModelDownloader::~ModelDownloader(){}
 
 void ModelDownloader::onFileDownloaded(QNetworkReply* pReply){
-    m_DownloadedData = pReply->readAll();
+    m_ModelFile.write(pReply->readAll());
+
+    if (pReply->error() == QNetworkReply::NoError && m_ModelFile.commit()) {
+        this->state = State::Completed;
+    } else {
+        m_ModelFile.cancelWriting();
+        this->state = State::Failed;
+    }
+
     // emit file downloaded signal.
     pReply->deleteLater();
     emit onModelDownloaded();
 }
 
+void ModelDownloader::onDataReceived(){
+    auto pReply = qobject_cast<QNetworkReply*>(sender());
+    if (pReply != nullptr) {
+        m_ModelFile.write(pReply->readAll());
+    }
+}
+
 void ModelDownloader::resume() {
     QFileInfo checkFile((std::filesystem::path(modelURL)));
 
@@ -40,6 +55,17 @@ void ModelDownloader::resume() {
         &m_WebCtrl, SIGNAL (finished(QNetworkReply*)),
         this, SLOT (onFileDownloaded(QNetworkReply*))
     );
+    m_ModelFile.setFileName(checkFile.absoluteFilePath());
+    if (!m_ModelFile.open(QIODevice::WriteOnly)) {
+        this->state = State::Failed;
+        return;
+    }
+
     QNetworkRequest request(requestURL);
-    m_WebCtrl.get(request);
+    auto pReply = m_WebCtrl.get(request);
+
+    connect(
+        pReply, SIGNAL (readyRead()),
+        this, SLOT (onDataReceived())
+    );
 }
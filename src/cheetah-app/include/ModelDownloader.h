@@ -9,6 +9,7 @@
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
+#include <QSaveFile>
 #include <QString>
 
 // modification of https://wiki.qt.io/Download_Data_from_URL sample from Qt wiki.
@@ -39,7 +40,6 @@ public:
     explicit ModelDownloader (std::string modelName);
 
     virtual ~ModelDownloader();
-    QByteArray downloadedData() const;
 
 signals:
     void onModelDownloaded();
@@ -47,10 +47,13 @@ signals:
 private slots:
 
     void onFileDownloaded(QNetworkReply* pReply);
+    void onDataReceived();
 
 private:
     QNetworkAccessManager m_WebCtrl;
-    QByteArray m_DownloadedData;
+    // written as the data arrives and only moved into place once complete, so the
+    // model is never held in memory and a partial download is never loaded
+    QSaveFile m_ModelFile;
 
     void resume();
 };
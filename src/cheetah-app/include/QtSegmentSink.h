@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+
+#include <QMetaObject>
+#include <QObject>
+#include <QString>
+
+#include <SegmentSink.h>
+
+// Turns the events of a WhisperStream subscription into signals emitted on the
+// thread the sink lives in, normally the GUI thread. The subscription's thread
+// only queues a call there and moves on, so the UI never blocks the delivery
+// of the next event and the receivers never see a foreign thread.
+//
+//     auto sink = QtSegmentSink::create();
+//     QObject::connect(sink.get(), &QtSegmentSink::segmentFinal, ...);
+//     auto id = stream.subscribe(sink);
+class QtSegmentSink : public QObject, public SegmentSink {
+    Q_OBJECT
+public:
+    // the last reference may go on the subscription's thread, so the object is deleted by its own event loop
+    static std::shared_ptr<QtSegmentSink> create() {
+        return std::shared_ptr<QtSegmentSink>(new QtSegmentSink(), [](QtSegmentSink *sink) { sink->deleteLater(); });
+    }
+
+    void onSegmentEvent(const SegmentEvent &event) override {
+        // calls still queued when the object is deleted are dropped along with it
+        QMetaObject::invokeMethod(this, [this, event]() {
+            const QString text = QString::fromStdString(event.segment.text);
+            const QString model = QString::fromStdString(event.segment.model);
+
+            switch (event.kind) {
+            case SegmentEvent::Partial:
+                emit segmentPartial(text, event.segment.t0, event.segment.t1, event.segment.speaker, model, event.version);
+                break;
+            case SegmentEvent::Final:
+                emit segmentFinal(text, event.segment.t0, event.segment.t1, event.segment.speaker, model, event.version);
+                break;
+            case SegmentEvent::Trimmed:
+                emit segmentsTrimmed(event.segment.t0, event.version);
+                break;
+            }
+        }, Qt::QueuedConnection);
+    }
+
+    void onOverflow(uint64_t n_dropped) override {
+        QMetaObject::invokeMethod(this, [this, n_dropped]() {
+            emit eventsDropped(n_dropped);
+        }, Qt::QueuedConnection);
+    }
+
+signals:
+    // empty text withdraws the previous partial segment of the speaker
+    // model is the path of the model that produced the text
+    void segmentPartial(QString text, quint64 t0, quint64 t1, int speaker, QString model, quint64 version);
+    void segmentFinal(QString text, quint64 t0, quint64 t1, int speaker, QString model, quint64 version);
+    void segmentsTrimmed(quint64 t0, quint64 version);
+
+    // events were lost to a full backlog, the latest snapshot has the current state
+    void eventsDropped(quint64 n);
+
+private:
+    QtSegmentSink() = default;
+};
@@ -0,0 +1,175 @@
+// Transcribe recorded audio without going through a capture device
+//
+// usage: cheetah-transcribe [options] file.wav|directory ...
+
+#include <common.h>
+#include <transcribe.h>
+#include <whisper_model.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct transcribe_cli_params {
+    transcribe_params transcribe;
+
+    bool output_txt = false;
+
+    std::string model = "models/ggml-base.en.bin";
+    std::vector<std::string> inputs;
+};
+
+static void transcribe_print_usage(int /*argc*/, char ** argv, const transcribe_cli_params & params) {
+    fprintf(stderr, "\n");
+    fprintf(stderr, "usage: %s [options] file.wav|directory ...\n", argv[0]);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "directories are searched recursively for .wav files, other rates than 16 kHz are resampled\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  -h,       --help          [default] show this help message and exit\n");
+    fprintf(stderr, "  -t N,     --threads N     [%-7d] number of threads to use during computation\n", params.transcribe.n_threads);
+    fprintf(stderr, "  -w N,     --workers N     [%-7d] number of chunks decoded in parallel, 0 for one per 4 threads\n", params.transcribe.n_workers);
+    fprintf(stderr, "  -c N,     --chunk N       [%-7d] maximum chunk length in milliseconds\n", params.transcribe.chunk_ms);
+    fprintf(stderr, "  -vth N,   --vad-thold N   [%-7.2f] voice activity detection threshold\n", params.transcribe.vad_thold);
+    fprintf(stderr, "  -fth N,   --freq-thold N  [%-7.2f] high-pass frequency cutoff\n", params.transcribe.freq_thold);
+    fprintf(stderr, "  -tr,      --translate     [%-7s] translate from source language to english\n", params.transcribe.translate ? "true" : "false");
+    fprintf(stderr, "  -l LANG,  --language LANG [%-7s] spoken language\n", params.transcribe.language.c_str());
+    fprintf(stderr, "  -m FNAME, --model FNAME   [%-7s] model path\n", params.model.c_str());
+    fprintf(stderr, "  -otxt,    --output-txt    [%-7s] write the transcript of file.wav to file.wav.txt\n", params.output_txt ? "true" : "false");
+    fprintf(stderr, "\n");
+}
+
+static bool transcribe_params_parse(int argc, char ** argv, transcribe_cli_params & params) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg[0] != '-') {
+            params.inputs.push_back(arg);
+            continue;
+        }
+
+        if (arg == "-h" || arg == "--help") {
+            transcribe_print_usage(argc, argv, params);
+            exit(0);
+        }
+
+        // every other option takes a value, except for the flags
+        if (arg == "-tr" || arg == "--translate") {
+            params.transcribe.translate = true;
+            continue;
+        } else if (arg == "-otxt" || arg == "--output-txt") {
+            params.output_txt = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "error: missing value for argument: %s\n", arg.c_str());
+            transcribe_print_usage(argc, argv, params);
+            exit(0);
+        }
+
+        if      (arg == "-t"   || arg == "--threads")    { params.transcribe.n_threads  = std::stoi(argv[++i]); }
+        else if (arg == "-w"   || arg == "--workers")    { params.transcribe.n_workers  = std::stoi(argv[++i]); }
+        else if (arg == "-c"   || arg == "--chunk")      { params.transcribe.chunk_ms   = std::stoi(argv[++i]); }
+        else if (arg == "-vth" || arg == "--vad-thold")  { params.transcribe.vad_thold  = std::stof(argv[++i]); }
+        else if (arg == "-fth" || arg == "--freq-thold") { params.transcribe.freq_thold = std::stof(argv[++i]); }
+        else if (arg == "-l"   || arg == "--language")   { params.transcribe.language   = argv[++i]; }
+        else if (arg == "-m"   || arg == "--model")      { params.model                 = argv[++i]; }
+        else {
+            fprintf(stderr, "error: unknown argument: %s\n", arg.c_str());
+            transcribe_print_usage(argc, argv, params);
+            exit(0);
+        }
+    }
+
+    return true;
+}
+
+// the input files in order, directories expanded to the .wav files below them
+static std::vector<std::string> transcribe_collect_inputs(const std::vector<std::string> & inputs) {
+    std::vector<std::string> files;
+
+    for (const auto & input : inputs) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(input, ec)) {
+            files.push_back(input);
+            continue;
+        }
+
+        std::vector<std::string> found;
+        for (const auto & entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+                found.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+
+    return files;
+}
+
+int main(int argc, char ** argv) {
+    transcribe_cli_params params;
+
+    if (!transcribe_params_parse(argc, argv, params)) {
+        return 1;
+    }
+
+    if (params.inputs.empty()) {
+        fprintf(stderr, "error: no input files specified\n");
+        transcribe_print_usage(argc, argv, params);
+        return 2;
+    }
+
+    const auto files = transcribe_collect_inputs(params.inputs);
+
+    // the weights are loaded once and shared by every worker of every file
+    auto model = whisper_model_acquire(params.model);
+    if (model == nullptr) {
+        fprintf(stderr, "error: failed to load model '%s'\n", params.model.c_str());
+        return 3;
+    }
+
+    int n_failed = 0;
+
+    for (const auto & file : files) {
+        OrderedSegments segments;
+
+        if (!transcribe_file(model, file, params.transcribe, segments)) {
+            fprintf(stderr, "error: failed to transcribe '%s'\n", file.c_str());
+            ++n_failed;
+            continue;
+        }
+
+        if (files.size() > 1) {
+            printf("%s:\n", file.c_str());
+        }
+
+        std::ofstream fout;
+        if (params.output_txt) {
+            fout.open(file + ".txt");
+            if (!fout.is_open()) {
+                fprintf(stderr, "error: failed to open '%s.txt' for writing\n", file.c_str());
+                ++n_failed;
+            }
+        }
+
+        for (const auto & segment : segments) {
+            // to_timestamp() counts in units of 10 ms
+            printf("[%s --> %s]  %s\n", to_timestamp(segment.t0/10).c_str(), to_timestamp(segment.t1/10).c_str(), segment.text.c_str());
+
+            if (fout.is_open()) {
+                fout << segment.text << "\n";
+            }
+        }
+
+        fflush(stdout);
+    }
+
+    return n_failed == 0 ? 0 : 4;
+}
@@ -0,0 +1,381 @@
+// End-to-end benchmark of the streaming path
+//
+// Replays WAV files through stream_init/stream_run_segments, the same calls
+// WhisperStream makes, and prints one JSON document with per-file latency,
+// throughput and loss figures and the peak memory of the whole run, so builds
+// and parameter sets can be compared.
+//
+// usage: libwhisper-bench [options] file.wav|directory ...
+
+#include <stream.h>
+#include <wav_reader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+struct bench_params {
+    stream_params_t stream = stream_default_params();
+
+    std::string model = "models/ggml-base.en.bin";
+    std::string final_model; // empty without a cascade
+    std::string language = "en";
+    std::vector<std::string> inputs;
+};
+
+// what one replay measured
+struct bench_result {
+    std::string file;
+
+    double audio_ms = 0.0;
+    double init_ms  = 0.0;
+    double wall_ms  = 0.0;
+    double ttft_ms  = -1.0; // from stream_init, which starts the replay, to the first text, -1 without text
+
+    std::vector<float> decode_ms;
+
+    int n_partial = 0;
+    int n_final   = 0;
+    int n_refined = 0; // final segments of the final model
+    int ret       = 0;
+
+    stream_stats_t stats {};
+};
+
+static void bench_print_usage(int /*argc*/, char ** argv, const bench_params & params) {
+    const auto & sp = params.stream;
+
+    fprintf(stderr, "\n");
+    fprintf(stderr, "usage: %s [options] file.wav|directory ...\n", argv[0]);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "directories are searched recursively for .wav files, other rates than 16 kHz are resampled\n");
+    fprintf(stderr, "the results are written to stdout as JSON\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  -h,       --help          [default] show this help message and exit\n");
+    fprintf(stderr, "  -t N,     --threads N     [%-7d] number of threads to use during computation\n", sp.n_threads);
+    fprintf(stderr, "            --step N        [%-7d] audio step size in milliseconds, 0 for VAD mode\n", sp.step_ms);
+    fprintf(stderr, "            --length N      [%-7d] audio length in milliseconds\n", sp.length_ms);
+    fprintf(stderr, "            --keep N        [%-7d] audio to keep from previous step in ms\n", sp.keep_ms);
+    fprintf(stderr, "  -ac N,    --audio-ctx N   [%-7d] audio context size, 0 for the full context, -1 automatic\n", sp.audio_ctx);
+    fprintf(stderr, "  -qd N,    --queue-depth N [%-7d] windows waiting for the decoder\n", sp.queue_depth);
+    fprintf(stderr, "  -op N,    --overflow N    [%-7d] 0 drop oldest, 1 coalesce, 2 degrade\n", (int) sp.overflow_policy);
+    fprintf(stderr, "  -pl N,    --placement N   [%-7d] 0 leaves the threads to the scheduler, 1 pins them to cores\n", (int) sp.placement);
+    fprintf(stderr, "  -sp N,    --speed N       [%-7.2f] replay speed, 1 for real time, 0 as fast as it is decoded\n", sp.source_speed);
+    fprintf(stderr, "  -ch N,    --channel N     [%-7d] channel of stereo files to transcribe, -1 mixes them\n", sp.channel);
+    fprintf(stderr, "  -vg,      --vad-gate      [%-7s] skip the steps without speech\n", sp.vad_gate ? "true" : "false");
+    fprintf(stderr, "  -inc,     --incremental   [%-7s] commit agreed text and trim its audio\n", sp.incremental ? "true" : "false");
+    fprintf(stderr, "  -na,      --no-adaptive   [%-7s] keep step and length fixed\n", sp.adaptive ? "false" : "true");
+    fprintf(stderr, "  -nw,      --no-warmup     [%-7s] skip the warmup decode\n", sp.warmup ? "false" : "true");
+    fprintf(stderr, "  -l LANG,  --language LANG [%-7s] spoken language\n", params.language.c_str());
+    fprintf(stderr, "  -m FNAME, --model FNAME   [%-7s] model path\n", params.model.c_str());
+    fprintf(stderr, "  -fm F,    --final-model F [%-7s] model that decodes committed utterances again, for a cascade\n", params.final_model.empty() ? "none" : params.final_model.c_str());
+    fprintf(stderr, "  -ft N,    --final-threads N [%-5d] threads of the final model, 0 for as many as -t\n", sp.final_n_threads);
+    fprintf(stderr, "\n");
+}
+
+static bool bench_params_parse(int argc, char ** argv, bench_params & params) {
+    auto & sp = params.stream;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg[0] != '-') {
+            params.inputs.push_back(arg);
+            continue;
+        }
+
+        if (arg == "-h" || arg == "--help") {
+            bench_print_usage(argc, argv, params);
+            exit(0);
+        }
+
+        if      (arg == "-inc" || arg == "--incremental") { sp.incremental = true;  continue; }
+        else if (arg == "-na"  || arg == "--no-adaptive") { sp.adaptive    = false; continue; }
+        else if (arg == "-nw"  || arg == "--no-warmup")   { sp.warmup      = false; continue; }
+        else if (arg == "-vg"  || arg == "--vad-gate")    { sp.vad_gate    = true;  continue; }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "error: missing value for argument: %s\n", arg.c_str());
+            bench_print_usage(argc, argv, params);
+            exit(0);
+        }
+
+        if      (arg == "-t"  || arg == "--threads")     { sp.n_threads       = std::stoi(argv[++i]); }
+        else if (                arg == "--step")        { sp.step_ms         = std::stoi(argv[++i]); }
+        else if (                arg == "--length")      { sp.length_ms       = std::stoi(argv[++i]); }
+        else if (                arg == "--keep")        { sp.keep_ms         = std::stoi(argv[++i]); }
+        else if (arg == "-ac" || arg == "--audio-ctx")   { sp.audio_ctx       = std::stoi(argv[++i]); }
+        else if (arg == "-qd" || arg == "--queue-depth") { sp.queue_depth     = std::stoi(argv[++i]); }
+        else if (arg == "-op" || arg == "--overflow")    { sp.overflow_policy = (stream_overflow_policy_t) std::stoi(argv[++i]); }
+        else if (arg == "-pl" || arg == "--placement")   { sp.placement       = (stream_placement_t) std::stoi(argv[++i]); }
+        else if (arg == "-sp" || arg == "--speed")       { sp.source_speed    = std::stof(argv[++i]); }
+        else if (arg == "-ch" || arg == "--channel")     { sp.channel         = std::stoi(argv[++i]); }
+        else if (arg == "-l"  || arg == "--language")    { params.language    = argv[++i]; }
+        else if (arg == "-m"  || arg == "--model")       { params.model       = argv[++i]; }
+        else if (arg == "-fm" || arg == "--final-model") { params.final_model = argv[++i]; }
+        else if (arg == "-ft" || arg == "--final-threads") { sp.final_n_threads = std::stoi(argv[++i]); }
+        else {
+            fprintf(stderr, "error: unknown argument: %s\n", arg.c_str());
+            bench_print_usage(argc, argv, params);
+            exit(0);
+        }
+    }
+
+    return true;
+}
+
+// the input files in order, directories expanded to the .wav files below them
+static std::vector<std::string> bench_collect_inputs(const std::vector<std::string> & inputs) {
+    std::vector<std::string> files;
+
+    for (const auto & input : inputs) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(input, ec)) {
+            files.push_back(input);
+            continue;
+        }
+
+        std::vector<std::string> found;
+        for (const auto & entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+                found.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+
+    return files;
+}
+
+// peak resident set size of the process so far, -1 where it cannot be queried
+// a high-water mark over every file run so far, so it is only reported once for all of them
+static long bench_peak_rss_kb() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+// nearest-rank percentile of sorted values
+static double bench_percentile(const std::vector<float> & sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    const size_t rank = (size_t) std::ceil(p / 100.0 * sorted.size());
+
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static std::string bench_json_string(const std::string & s) {
+    std::string result = "\"";
+    for (const char c : s) {
+        switch (c) {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n";  break;
+            case '\t': result += "\\t";  break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    result += buf;
+                } else {
+                    result += c;
+                }
+        }
+    }
+
+    return result + "\"";
+}
+
+static bench_result bench_run(const bench_params & params, const std::string & file) {
+    using clock = std::chrono::steady_clock;
+
+    bench_result result;
+    result.file = file;
+
+    {
+        wav_reader reader;
+        if (reader.open_file(file)) {
+            result.audio_ms = (1000.0 * reader.n_frames()) / std::max(1, reader.sample_rate());
+        }
+    }
+
+    auto sparams = params.stream;
+    sparams.model       = params.model.c_str();
+    sparams.final_model = params.final_model.empty() ? NULL : params.final_model.c_str();
+    sparams.language    = params.language.c_str();
+    sparams.source      = file.c_str();
+
+    const auto t_init = clock::now();
+
+    auto ctx = stream_init(sparams);
+    if (ctx == nullptr) {
+        result.ret = -1;
+        return result;
+    }
+
+    const auto t_start = clock::now();
+    result.init_ms = std::chrono::duration<double, std::milli>(t_start - t_init).count();
+
+    struct run_state {
+        bench_result & result;
+        clock::time_point t_start;
+        const char *final_model;
+    } state = { result, t_init, sparams.final_model };
+
+    auto callback = +[](const stream_segment_t *segment, void *data) -> int {
+        auto state = static_cast<run_state *>(data);
+
+        if (segment->kind == STREAM_SEGMENT_FINAL) {
+            ++state->result.n_final;
+            state->result.n_refined += state->final_model != NULL && strcmp(segment->model, state->final_model) == 0;
+        } else {
+            ++state->result.n_partial;
+        }
+
+        if (state->result.ttft_ms < 0.0 && segment->text[0] != '\0') {
+            state->result.ttft_ms = std::chrono::duration<double, std::milli>(clock::now() - state->t_start).count();
+        }
+
+        return 0;
+    };
+
+    uint64_t n_decoded = 0;
+
+    while (true) {
+        const int ret = stream_run_segments(ctx, &state, callback);
+
+        stream_get_stats(ctx, &result.stats);
+        if (result.stats.n_decoded > n_decoded) {
+            n_decoded = result.stats.n_decoded;
+            result.decode_ms.push_back(result.stats.last_decode_ms);
+        }
+
+        if (ret != 0) {
+            result.ret = ret == STREAM_RUN_END ? 0 : ret;
+            break;
+        }
+    }
+
+    result.wall_ms = std::chrono::duration<double, std::milli>(clock::now() - t_start).count();
+
+    stream_free(ctx);
+
+    return result;
+}
+
+static void bench_print_result(const bench_result & result, bool last) {
+    auto decode_ms = result.decode_ms;
+    std::sort(decode_ms.begin(), decode_ms.end());
+
+    double decode_ms_total = 0.0;
+    for (const float ms : decode_ms) {
+        decode_ms_total += ms;
+    }
+
+    const auto & stats = result.stats;
+
+    printf("    {\n");
+    printf("      \"file\": %s,\n", bench_json_string(result.file).c_str());
+    printf("      \"ok\": %s,\n", result.ret == 0 ? "true" : "false");
+    printf("      \"audio_ms\": %.1f,\n", result.audio_ms);
+    printf("      \"init_ms\": %.1f,\n", result.init_ms);
+    printf("      \"warmup_ms\": %d,\n", stats.warmup_ms);
+    printf("      \"wall_ms\": %.1f,\n", result.wall_ms);
+    printf("      \"ttft_ms\": %.1f,\n", result.ttft_ms);
+    printf("      \"decode_ms\": { \"n\": %zu, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"total\": %.1f },\n",
+            decode_ms.size(),
+            bench_percentile(decode_ms, 50), bench_percentile(decode_ms, 90), bench_percentile(decode_ms, 99),
+            decode_ms.empty() ? 0.0 : decode_ms.back(), decode_ms_total);
+    printf("      \"rtf\": %.4f,\n", result.audio_ms > 0.0 ? decode_ms_total / result.audio_ms : 0.0);
+    printf("      \"segments\": { \"partial\": %d, \"final\": %d, \"refined\": %d },\n", result.n_partial, result.n_final, result.n_refined);
+    printf("      \"windows\": { \"assembled\": %llu, \"decoded\": %llu, \"dropped\": %llu, \"coalesced\": %llu, \"degraded\": %llu, \"retried\": %llu, \"gated\": %llu },\n",
+            (unsigned long long) stats.n_windows, (unsigned long long) stats.n_decoded, (unsigned long long) stats.n_dropped,
+            (unsigned long long) stats.n_coalesced, (unsigned long long) stats.n_degraded, (unsigned long long) stats.n_retried,
+            (unsigned long long) stats.n_gated);
+    printf("      \"samples_dropped\": %llu,\n", (unsigned long long) stats.n_samples_dropped);
+    printf("      \"samples_lost\": %llu,\n", (unsigned long long) stats.n_samples_lost);
+    printf("      \"queue_depth_max\": %d,\n", stats.queue_depth_max);
+    printf("      \"final_step_ms\": %d,\n", stats.step_ms);
+    printf("      \"final_length_ms\": %d\n", stats.length_ms);
+    printf("    }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char ** argv) {
+    bench_params params;
+
+    if (!bench_params_parse(argc, argv, params)) {
+        return 1;
+    }
+
+    if (params.inputs.empty()) {
+        fprintf(stderr, "error: no input files specified\n");
+        bench_print_usage(argc, argv, params);
+        return 2;
+    }
+
+    const auto files = bench_collect_inputs(params.inputs);
+    const auto & sp = params.stream;
+
+    printf("{\n");
+    printf("  \"params\": {\n");
+    printf("    \"model\": %s,\n", bench_json_string(params.model).c_str());
+    printf("    \"final_model\": %s,\n", params.final_model.empty() ? "null" : bench_json_string(params.final_model).c_str());
+    printf("    \"language\": %s,\n", bench_json_string(params.language).c_str());
+    printf("    \"n_threads\": %d,\n", sp.n_threads);
+    printf("    \"step_ms\": %d,\n", sp.step_ms);
+    printf("    \"length_ms\": %d,\n", sp.length_ms);
+    printf("    \"keep_ms\": %d,\n", sp.keep_ms);
+    printf("    \"audio_ctx\": %d,\n", sp.audio_ctx);
+    printf("    \"queue_depth\": %d,\n", sp.queue_depth);
+    printf("    \"overflow_policy\": %d,\n", (int) sp.overflow_policy);
+    printf("    \"placement\": %d,\n", (int) sp.placement);
+    printf("    \"speed\": %.2f,\n", sp.source_speed);
+    printf("    \"incremental\": %s,\n", sp.incremental ? "true" : "false");
+    printf("    \"channel\": %d,\n", sp.channel);
+    printf("    \"vad_gate\": %s,\n", sp.vad_gate ? "true" : "false");
+    printf("    \"adaptive\": %s,\n", sp.adaptive ? "true" : "false");
+    printf("    \"warmup\": %s\n", sp.warmup ? "true" : "false");
+    printf("  },\n");
+    printf("  \"files\": [\n");
+
+    int n_failed = 0;
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        fprintf(stderr, "%s: [%zu/%zu] %s\n", __func__, i + 1, files.size(), files[i].c_str());
+
+        const auto result = bench_run(params, files[i]);
+        n_failed += result.ret != 0;
+
+        bench_print_result(result, i + 1 == files.size());
+        fflush(stdout);
+    }
+
+    printf("  ],\n");
+    printf("  \"peak_rss_kb\": %ld\n", bench_peak_rss_kb());
+    printf("}\n");
+
+    return n_failed == 0 ? 0 : 3;
+}